@@ -2,10 +2,12 @@
  * @brief Argument parser class implementation.
  * @author Tomáš Milostný (xmilos02)
  */
+#include <cmath>
 #include <getopt.h>
 #include <iostream>
 #include <malloc.h>
 #include <regex>
+#include <sched.h>
 #include <stdexcept>
 #include <string.h>
 #include <vector>
@@ -71,6 +73,18 @@ void _FreeArgv(int argc, char** argv)
     free(argv);
 }
 
+/// Options without a short form, their values are used as getopt option characters.
+const struct option longOptions[] =
+{
+    { "rate",     required_argument, NULL, 'r' },
+    { "adaptive", no_argument,       NULL, 'A' },
+    { "sparse",   no_argument,       NULL, 'S' },
+    { "priority", required_argument, NULL, 'P' },
+    { "mirror",   required_argument, NULL, 'D' },
+    { "sessions", required_argument, NULL, 'N' },
+    { NULL,       0,                 NULL, 0 }
+};
+
 ArgumentParser::ArgumentParser(std::string args)
 {
     HelpFlag = args == "help";
@@ -93,6 +107,12 @@ ArgumentParser::ArgumentParser(std::string args)
     Domain = AF_INET;
     Port = 69;
     TransferMode = "octet";
+    Profile = "default";
+    Cpu = -1;
+    Rate = 0;
+    Adaptive = Decompress = Sparse = false;
+    Priority = 0;
+    Sessions = 4;
 
     // Load argc and argv for getopt from string.
     int argc; char** argv;
@@ -105,13 +125,14 @@ ArgumentParser::ArgumentParser(std::string args)
         throw std::invalid_argument(exc.what());
     }
     // Arguments loaded, prepare flags and reset getopt.
-    bool destFlag = false, timeoutFlag = false, sizeFlag = false, transModeFlag = false, addrFlag = false;
+    bool destFlag = false, timeoutFlag = false, sizeFlag = false, transModeFlag = false, addrFlag = false, profileFlag = false;
+    bool rateFlag = false, priorityFlag = false, sessionsFlag = false;
     int option;
     optind = 0;
     try
     {
         // Parse arguments using getopt.
-        while ((option = getopt(argc, argv, "RWd:t:s:mc:a:")) != -1)
+        while ((option = getopt_long(argc, argv, "RWd:t:s:mc:a:p:z", longOptions, NULL)) != -1)
         {
             switch (option)
             {
@@ -123,6 +144,14 @@ ArgumentParser::ArgumentParser(std::string args)
             case 'm':   ParseMulticast();                   break;
             case 'c':   ParseMode(transModeFlag, optarg);   break;
             case 'a':   ParseAddress(addrFlag, optarg);     break;
+            case 'p':   ParseProfile(profileFlag, optarg);  break;
+            case 'r':   ParseRate(rateFlag, optarg);        break;
+            case 'A':   ParseAdaptive();                    break;
+            case 'z':   ParseDecompress();                  break;
+            case 'S':   ParseSparse();                      break;
+            case 'P':   ParsePriority(priorityFlag, optarg); break;
+            case 'D':   ParseMirror(optarg);                break;
+            case 'N':   ParseSessions(sessionsFlag, optarg); break;
             default:
                 throw std::invalid_argument(args);
                 break;
@@ -132,8 +161,21 @@ ArgumentParser::ArgumentParser(std::string args)
         if (!ReadMode && !WriteMode)
             throw std::invalid_argument("Missing required argument -R (read mode) or -W (write mode).");
 
-        if (!destFlag)
+        // Directory upload takes file names from the directory, -d is an optional remote prefix then.
+        if (!destFlag && !(WriteMode && !MirrorDirectory.empty()))
             throw std::invalid_argument("Missing required argument -d <file-path>.");
+
+        if (!MirrorDirectory.empty() && Decompress)
+            throw std::invalid_argument("Argument -z can't be combined with --mirror.");
+
+        if (Decompress && (WriteMode || TransferMode != "octet"))
+            throw std::invalid_argument("Argument -z can be used only in read mode (-R) with octet transfer mode.");
+
+        if (Sparse && (WriteMode || TransferMode != "octet"))
+            throw std::invalid_argument("Argument --sparse can be used only in read mode (-R) with octet transfer mode.");
+
+        if (WriteMode && Mirrors.size() > 1)
+            throw std::invalid_argument("Multiple servers in argument -a are supported only in read mode (-R).");
     }
     catch (const std::invalid_argument&)
     {
@@ -146,7 +188,9 @@ ArgumentParser::ArgumentParser(std::string args)
         ServerAddress.v4.sin_family = AF_INET;
         ServerAddress.v4.sin_port = htons(Port);
         inet_pton(Domain, AddressStr.c_str(), &ServerAddress.v4.sin_addr);
+        Mirrors.push_back({ AddressStr, Hostname, Resolution, ServerAddress, Domain, Port });
     }
+    LocalPath = DestinationPath;
     _FreeArgv(argc, argv);
 }
 
@@ -260,7 +304,38 @@ void ArgumentParser::ParseAddress(bool& addressFlag, std::string optionArg)
     if (addressFlag)
         throw std::invalid_argument("Argument -a already set to '" + AddressStr + "'.");
 
-    // Extract port part of the address option value to port field.
+    // Servers in the mirror list are separated by ';'.
+    size_t start = 0, end;
+    do
+    {
+        end = optionArg.find(';', start);
+        ParseServer(optionArg.substr(start, end == std::string::npos ? end : end - start));
+        start = end + 1;
+    }
+    while (end != std::string::npos);
+
+    SelectMirror(0);
+    addressFlag = true;
+}
+
+void ArgumentParser::SelectMirror(size_t index)
+{
+    auto& mirror = Mirrors.at(index);
+    AddressStr = mirror.AddressStr;
+    Hostname = mirror.Hostname;
+    Resolution = mirror.Resolution;
+    ServerAddress = mirror.ServerAddress;
+    Domain = mirror.Domain;
+    Port = mirror.Port;
+}
+
+void ArgumentParser::ParseServer(std::string optionArg)
+{
+    // Each server starts from defaults, extract port part of the address option value to port field.
+    Port = 69;
+    Domain = AF_INET;
+    Hostname.clear();
+    Resolution = ResolvedAddresses();
     _ExtractPort(optionArg, Port);
 
     // Create and check IP address struct with inet_pton.
@@ -272,7 +347,19 @@ void ArgumentParser::ParseAddress(bool& addressFlag, std::string optionArg)
     {
         status = inet_pton(Domain = AF_INET6, optionArg.c_str(), &ServerAddress.v6.sin6_addr);
         if (status <= 0)
-            throw std::invalid_argument("inet_pton: Bad IP address format: " + optionArg);        
+        {
+            // Not an IP address, start resolving it as a hostname until the transfer begins.
+            if (optionArg.size() > 253 || !std::regex_match(optionArg, std::regex(
+                "[A-Za-z0-9]([A-Za-z0-9-]{0,61}[A-Za-z0-9])?(\\.[A-Za-z0-9]([A-Za-z0-9-]{0,61}[A-Za-z0-9])?)*\\.?")))
+            {
+                throw std::invalid_argument("Bad IP address or hostname format: " + optionArg);
+            }
+            Domain = AF_UNSPEC;
+            AddressStr = Hostname = optionArg;
+            Resolution = Resolver::ResolveAsync(Hostname);
+            Mirrors.push_back({ AddressStr, Hostname, Resolution, ServerAddress, Domain, Port });
+            return;
+        }
     }
     // Based on result AF, fill information for the socket hint structure.
     switch (Domain)
@@ -289,7 +376,136 @@ void ArgumentParser::ParseAddress(bool& addressFlag, std::string optionArg)
         break;
     }
     AddressStr = strBuffer;
-    addressFlag = true;
+    Mirrors.push_back({ AddressStr, Hostname, Resolution, ServerAddress, Domain, Port });
+}
+
+void ArgumentParser::ParseProfile(bool& profileFlag, std::string optionArg)
+{
+    if (profileFlag)
+        throw std::invalid_argument("Argument -p is already set to '" + Profile + "'.");
+
+    // Optional CPU number after ',' pins the transfer.
+    int commaPos = optionArg.find_last_of(',');
+    if (commaPos != -1)
+    {
+        auto cpuStr = optionArg.substr(commaPos + 1);
+        try
+        {
+            Cpu = std::stoi(cpuStr);
+            if (Cpu < 0 || Cpu >= CPU_SETSIZE)
+                throw std::exception();
+        }
+        catch (const std::exception&)
+        {
+            throw std::invalid_argument("Invalid CPU number for argument -p: " + cpuStr);
+        }
+        optionArg.erase(commaPos);
+    }
+    if (optionArg != "default" && optionArg != "lowlatency")
+        throw std::invalid_argument("Invalid value for argument -p: " + optionArg);
+
+    Profile = optionArg;
+    profileFlag = true;
+}
+
+void ArgumentParser::ParseRate(bool& rateFlag, std::string optionArg)
+{
+    if (rateFlag)
+        throw std::invalid_argument("Argument --rate is already set to '" + std::to_string((long)Rate) + "'.");
+    try
+    {
+        // Number of bytes per second with an optional decimal k/M/G suffix.
+        size_t suffixPos;
+        Rate = std::stod(optionArg, &suffixPos);
+        auto suffix = optionArg.substr(suffixPos);
+
+        if (suffix == "k" || suffix == "K")
+            Rate *= 1e3;
+        else if (suffix == "M")
+            Rate *= 1e6;
+        else if (suffix == "G")
+            Rate *= 1e9;
+        else if (!suffix.empty())
+            throw std::exception();
+
+        if (!std::isfinite(Rate) || Rate < 1)
+            throw std::exception();
+    }
+    catch (const std::exception&)
+    {
+        throw std::invalid_argument("Invalid value for argument --rate: " + optionArg + " (bytes per second, optional k/M/G suffix)");
+    }
+    rateFlag = true;
+}
+
+void ArgumentParser::ParseAdaptive()
+{
+    if (Adaptive)
+        throw std::invalid_argument("Argument --adaptive is already set.");
+
+    Adaptive = true;
+}
+
+void ArgumentParser::ParseDecompress()
+{
+    if (Decompress)
+        throw std::invalid_argument("Argument -z is already set.");
+
+    Decompress = true;
+}
+
+void ArgumentParser::ParseSparse()
+{
+    if (Sparse)
+        throw std::invalid_argument("Argument --sparse is already set.");
+
+    Sparse = true;
+}
+
+void ArgumentParser::ParsePriority(bool& priorityFlag, std::string optionArg)
+{
+    if (priorityFlag)
+        throw std::invalid_argument("Argument --priority is already set to '" + std::to_string(Priority) + "'.");
+    try
+    {
+        size_t end;
+        Priority = std::stoi(optionArg, &end);
+        if (end != optionArg.size())
+            throw std::exception();
+    }
+    catch (const std::exception&)
+    {
+        throw std::invalid_argument("Invalid value for argument --priority: " + optionArg);
+    }
+    priorityFlag = true;
+}
+
+void ArgumentParser::ParseMirror(std::string optionArg)
+{
+    if (!MirrorDirectory.empty())
+        throw std::invalid_argument("Argument --mirror is already set to '" + MirrorDirectory + "'.");
+    if (optionArg.empty())
+        throw std::invalid_argument("Argument --mirror requires a directory.");
+
+    MirrorDirectory = optionArg;
+}
+
+void ArgumentParser::ParseSessions(bool& sessionsFlag, std::string optionArg)
+{
+    if (sessionsFlag)
+        throw std::invalid_argument("Argument --sessions is already set to '" + std::to_string(Sessions) + "'.");
+    try
+    {
+        size_t end;
+        Sessions = std::stoi(optionArg, &end);
+        if (end != optionArg.size() || Sessions < 1)
+            throw std::exception();
+    }
+    catch (const std::exception&)
+    {
+        throw std::invalid_argument("Invalid value for argument --sessions: " + optionArg + " (must be at least 1)");
+    }
+    sessionsFlag = true;
 }
 
 void ArgumentParser::DisplayHelp()
@@ -302,7 +518,19 @@ void ArgumentParser::DisplayHelp()
     std::cout << "  -s <size>\t\tBlock size. (default: 512)" << std::endl;
     std::cout << "  -m\t\t\tMulticast mode." << std::endl;
     std::cout << "  -c <mode>\t\tTransfer mode (\"octet\"/\"binary\" or \"ascii\"/\"netascii\", default: \"octet\")" << std::endl;
-    std::cout << "  -a <address>,<port>\tIPv4 or IPv6 address and port of the TFTP server. (default: 127.0.0.1,69)" << std::endl;
+    std::cout << "  -a <address>,<port>\tIPv4/IPv6 address or hostname and port of the TFTP server. (default: 127.0.0.1,69)" << std::endl;
+    std::cout << "  -a <addr>,<port>;...\tList of mirror servers for read mode, the fastest one is used and others are failover." << std::endl;
+
+    std::cout << "  -z\t\t\tDecompress downloaded gzip/zstd file while receiving, output path drops .gz/.zst suffix." << std::endl;
+    std::cout << "  --sparse\t\tSkip writing zero pages of downloaded file, creating a sparse file." << std::endl;
+    std::cout << "  --priority <n>\tScheduling priority in batch mode (-j), higher goes first (default: 0)." << std::endl;
+    std::cout << "  --mirror <dir>\tSynchronize a directory: -W uploads its changed files (-d is an optional remote prefix)," << std::endl;
+    std::cout << "\t\t\t-R downloads changed files of the sha256sum list given by -d. State is kept in <dir>/.tftpstate." << std::endl;
+    std::cout << "  --sessions <n>\tParallel transfers of --mirror. (default: 4)" << std::endl;
+    std::cout << "  -p <profile>,<cpu>\tSocket tuning profile (\"default\" or \"lowlatency\"), optionally pin the transfer to a CPU." << std::endl;
+
+    std::cout << "  --rate <rate>\t\tTransfer rate limit in bytes per second, optional k/M/G suffix (e.g. 10M)." << std::endl;
+    std::cout << "  --adaptive\t\tAdjust transfer rate by measured round trips (back off on queueing delay)." << std::endl;
 
     std::cout << std::endl << "Other commands:" << std::endl;
     std::cout << "  help\t\t\tDisplay this help." << std::endl;
@@ -5,12 +5,18 @@
 #pragma once
 #include <arpa/inet.h>
 #include <string>
+#include <vector>
+#include "Resolver.hpp"
 
-/// Holds either IPv4 or IPv6 struct value.
-union ServerAddress
+/// Server from argument -a, the list may hold more mirrors of the same files.
+struct ServerMirror
 {
-    struct sockaddr_in  v4;
-    struct sockaddr_in6 v6;
+    std::string         AddressStr;
+    std::string         Hostname;
+    ResolvedAddresses   Resolution;
+    union ServerAddress ServerAddress;
+    int                 Domain;
+    int                 Port;
 };
 
 /**
@@ -23,10 +29,14 @@ class ArgumentParser
         // Parse given program parameters into ArgumentParser class attributes.
         ArgumentParser(std::string args);
 
+        // Set server fields (ServerAddress, Domain, Port, AddressStr, ...) to the mirror from the list.
+        void SelectMirror(size_t index);
+
         // Fields for application arguments.
         bool             ReadMode;        // Argument -R, read mode (required if -W is not set, otherwise forbidden).
         bool             WriteMode;       // Argument -W, write mode (required if -R is not set, otherwise forbidden).
         std::string      DestinationPath; // Argument -d, destination file to (read to)/(write from) (required).
+        std::string      LocalPath;       // Local file of the transfer, DestinationPath unless set by the directory mirror.
         int              Timeout;         // Argument -t, timeout in seconds.
         size_t           Size;            // Argument -s, max size of blocks in octets.
         bool             Multicast;       // Argument -m, enables multicast communication.
@@ -35,6 +45,18 @@ class ArgumentParser
         int              Domain;          // AF_INET or AF_INET6
         int              Port;            // Argument -a after ',' symbol
         std::string      AddressStr;      // Address in string form
+        std::string      Profile;         // Argument -p, socket tuning profile ("default" or "lowlatency").
+        int              Cpu;             // Argument -p after ',' symbol, CPU to pin the transfer to (-1 if not set).
+        double           Rate;            // Argument --rate, transfer rate limit in bytes per second (0 if unlimited).
+        bool             Adaptive;        // Argument --adaptive, adjust transfer rate by measured round trips.
+        bool             Decompress;      // Argument -z, decompress downloaded .gz/.zst file while receiving.
+        bool             Sparse;          // Argument --sparse, leave zero pages of downloaded file as holes.
+        int              Priority;        // Argument --priority, batch mode scheduling priority (higher goes first).
+        std::string      MirrorDirectory; // Argument --mirror, local directory synchronized with the server (empty if not set).
+        int              Sessions;        // Argument --sessions, parallel transfers of the directory mirror.
+        std::string      Hostname;        // Argument -a if it is not an IP address (empty otherwise).
+        ResolvedAddresses Resolution;     // Addresses of Hostname, resolved in the background.
+        std::vector<ServerMirror> Mirrors;// All servers from argument -a separated by ';', fields above hold the selected one.
 
         bool             ExitFlag;        // Exit or quit command flag.
         bool             HelpFlag;        // Help command flag.
@@ -48,6 +70,15 @@ class ArgumentParser
         void ParseMulticast();
         void ParseMode(bool& modeFlag, std::string optionArg);
         void ParseAddress(bool& addressFlag, std::string optionArg);
+        void ParseServer(std::string optionArg);
+        void ParseProfile(bool& profileFlag, std::string optionArg);
+        void ParseRate(bool& rateFlag, std::string optionArg);
+        void ParseAdaptive();
+        void ParseDecompress();
+        void ParseSparse();
+        void ParsePriority(bool& priorityFlag, std::string optionArg);
+        void ParseMirror(std::string optionArg);
+        void ParseSessions(bool& sessionsFlag, std::string optionArg);
 
         void DisplayHelp();
 };
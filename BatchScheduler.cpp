@@ -0,0 +1,225 @@
+/**
+ * @brief Batch transfer scheduler implementation.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include "BatchScheduler.hpp"
+#include "Decompressor.hpp"
+#include "SocketTuning.hpp"
+#include "StampMessagePrinter.hpp"
+#include "TftpCodec.hpp"
+
+thread_local const BatchScheduler::Job* BatchScheduler::CurrentJob = NULL;
+
+BatchScheduler::BatchScheduler(size_t workers, size_t memoryBudget, size_t descriptorBudget)
+{
+    Workers = std::max<size_t>(workers, 1);
+    MemoryBudget = memoryBudget;
+    DescriptorBudget = descriptorBudget;
+    MemoryUsed = DescriptorsUsed = Running = 0;
+    Elapsed = TotalDelay = MaxDelay = Clock::duration::zero();
+    Succeeded = Failed = Lowered = PeakMemory = PeakRunning = 0;
+}
+
+void BatchScheduler::Submit(ArgumentParser* args, size_t line)
+{
+    Job job;
+    job.Args.reset(args);
+    job.Line = line;
+    job.Memory = job.Descriptors = 0;
+
+    //Size of an upload is known from the local file, download size comes only with the OACK.
+    struct stat info;
+    job.EstimatedSize = SIZE_MAX;
+    if (args->WriteMode && stat(args->LocalPath.c_str(), &info) == 0)
+        job.EstimatedSize = info.st_size;
+
+    std::lock_guard<std::mutex> lock(BudgetMutex);
+    Queue.push_back(std::move(job));
+}
+
+size_t BatchScheduler::DefaultMemoryBudget()
+{
+    return sysconf(_SC_AVPHYS_PAGES) * (size_t)sysconf(_SC_PAGESIZE) / 2;
+}
+
+size_t BatchScheduler::DefaultDescriptorBudget()
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur > DescriptorReserve)
+        return limit.rlim_cur - DescriptorReserve;
+    return 64;
+}
+
+size_t BatchScheduler::MemoryCost(const ArgumentParser* args, size_t blockSize)
+{
+    size_t packetSize = TftpCodec::HeaderSize + blockSize;
+
+    //Block buffer and the first DATA packet kept after an RRQ without OACK.
+    size_t cost = TransferOverhead + 2 * packetSize;
+
+    //Kernel socket buffers sized by the low-latency profile, both directions.
+    if (args->Profile == "lowlatency")
+        cost += 2 * packetSize * SocketTuning::InFlightBlocks;
+
+    //Decompression queue slots, output buffer and zlib/zstd state.
+    if (args->Decompress)
+        cost += Decompressor::QueueCapacity * packetSize + Decompressor::OutputBufferSize + InflateStateSize;
+
+    //Directory mirror runs up to --sessions such transfers at once.
+    if (!args->MirrorDirectory.empty())
+        cost *= args->Sessions;
+    return cost;
+}
+
+size_t BatchScheduler::DescriptorCost(const ArgumentParser* args)
+{
+    //Destination file and one socket per raced address, a hostname may race both address families.
+    size_t descriptors = 1;
+    for (auto& mirror : args->Mirrors)
+        descriptors += mirror.Hostname.empty() ? 1 : 2;
+
+    if (!args->MirrorDirectory.empty())
+        descriptors *= args->Sessions;
+    return descriptors;
+}
+
+bool BatchScheduler::JobBudget(size_t& memoryBudget, size_t& descriptorBudget)
+{
+    if (CurrentJob == NULL)
+        return false;
+
+    memoryBudget = CurrentJob->Memory;
+    descriptorBudget = CurrentJob->Descriptors;
+    return true;
+}
+
+bool BatchScheduler::Admit(Job& job)
+{
+    std::unique_lock<std::mutex> lock(BudgetMutex);
+    while (true)
+    {
+        if (Queue.empty())
+            return false;
+
+        //Scheduling order: higher priority, smaller file, earlier line.
+        auto next = std::min_element(Queue.begin(), Queue.end(), [](const Job& a, const Job& b) {
+            if (a.Args->Priority != b.Args->Priority)
+                return a.Args->Priority > b.Args->Priority;
+            if (a.EstimatedSize != b.EstimatedSize)
+                return a.EstimatedSize < b.EstimatedSize;
+            return a.Line < b.Line;
+        });
+        auto args = next->Args.get();
+        auto descriptors = DescriptorCost(args);
+        auto memoryFree = MemoryBudget > MemoryUsed ? MemoryBudget - MemoryUsed : 0;
+
+        //Halve the requested block size while the transfer does not fit the memory left.
+        auto blockSize = args->Size;
+        auto minBlockSize = std::min(args->Size, MinBlockSize);
+        while (MemoryCost(args, blockSize) > memoryFree && blockSize > minBlockSize)
+            blockSize = std::max(blockSize / 2, minBlockSize);
+
+        bool fits = MemoryCost(args, blockSize) <= memoryFree && DescriptorsUsed + descriptors <= DescriptorBudget;
+        if (fits || Running == 0)
+        {
+            job = std::move(*next);
+            Queue.erase(next);
+
+            if (blockSize < args->Size)
+            {
+                StampMessagePrinter::Print("Memory budget is tight, block size of line " + std::to_string(job.Line)
+                    + " lowered from " + std::to_string(args->Size) + " to " + std::to_string(blockSize) + ".");
+                args->Size = blockSize;
+                Lowered++;
+            }
+            if (!fits) //Running alone, there is nothing to wait for.
+                StampMessagePrinter::PrintError("Transfer of line " + std::to_string(job.Line) + " exceeds the batch budget, running it alone.");
+
+            job.Memory = MemoryCost(args, blockSize);
+            job.Descriptors = descriptors;
+            MemoryUsed += job.Memory;
+            DescriptorsUsed += job.Descriptors;
+            Running++;
+            PeakMemory = std::max(PeakMemory, MemoryUsed);
+            PeakRunning = std::max(PeakRunning, Running);
+
+            auto delay = Clock::now() - Start;
+            TotalDelay += delay;
+            MaxDelay = std::max(MaxDelay, delay);
+            return true;
+        }
+        BudgetChanged.wait(lock);
+    }
+}
+
+void BatchScheduler::Release(const Job& job, bool succeeded)
+{
+    {
+        std::lock_guard<std::mutex> lock(BudgetMutex);
+        MemoryUsed -= job.Memory;
+        DescriptorsUsed -= job.Descriptors;
+        Running--;
+        (succeeded ? Succeeded : Failed)++;
+    }
+    BudgetChanged.notify_all();
+}
+
+void BatchScheduler::Work(const JobFunction& run)
+{
+    Job job;
+    while (Admit(job))
+    {
+        //Messages of the transfer are marked with its command line number.
+        StampMessagePrinter::SetThreadPrefix("#" + std::to_string(job.Line) + ": ");
+        CurrentJob = &job;
+        bool succeeded = run(job.Args.get());
+        CurrentJob = NULL;
+        StampMessagePrinter::SetThreadPrefix("");
+
+        Release(job, succeeded);
+        job.Args.reset();
+    }
+}
+
+size_t BatchScheduler::Run(JobFunction run)
+{
+    //All jobs are queued from the start of the run, admission delay is their queueing delay.
+    Start = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < std::min(Workers, Queue.size()); i++)
+        threads.emplace_back(&BatchScheduler::Work, this, std::cref(run));
+
+    for (auto& thread : threads)
+        thread.join();
+
+    Elapsed = Clock::now() - Start;
+    return Failed;
+}
+
+std::string BatchScheduler::Describe() const
+{
+    auto jobs = Succeeded + Failed;
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << "Batch of " << jobs << " transfers (" << Succeeded << " succeeded, " << Failed << " failed)";
+    ss << " in " << std::chrono::duration<double>(Elapsed).count() << " s";
+    ss << ", queueing delay avg " << (jobs ? std::chrono::duration<double, std::milli>(TotalDelay).count() / jobs : 0) << " ms";
+    ss << " max " << std::chrono::duration<double, std::milli>(MaxDelay).count() << " ms";
+    ss << ", peak " << PeakRunning << " concurrent, " << PeakMemory << " B of " << MemoryBudget << " B budget";
+    ss << ", " << Lowered << " with lowered block size";
+
+    //ru_maxrss is in kilobytes on Linux.
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        ss << ", peak RSS " << usage.ru_maxrss * 1024 << " B";
+    return ss.str();
+}
@@ -0,0 +1,111 @@
+/**
+ * @brief Batch transfer scheduler module.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ArgumentParser.hpp"
+
+/**
+ * @brief Runs transfers concurrently, admitting each against a global memory and file descriptor budget.
+ *        Waiting jobs go by --priority (higher first), then smaller files first (downloads count as largest),
+ *        then in submission order. When a job does not fit, its requested block size is halved down to
+ *        MinBlockSize; a job that still does not fit waits for running ones, unless nothing else runs.
+ */
+class BatchScheduler
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /// Runs one transfer, @returns True on success.
+        using JobFunction = std::function<bool(ArgumentParser* args)>;
+
+        static constexpr size_t MinBlockSize = 512;         //Block size is not lowered below this (RFC 1350 size).
+        static constexpr size_t InflateStateSize = 49152;   //zlib inflate state with its 32 KiB window.
+        static constexpr size_t TransferOverhead = 65536;   //Stacks, stdio buffer and bookkeeping of one transfer.
+        static constexpr size_t DescriptorReserve = 16;     //Descriptors left for stdio, resolver and the state database.
+
+        /**
+         * @param workers Maximum number of concurrent transfers.
+         * @param memoryBudget Bytes all admitted transfers may use together.
+         * @param descriptorBudget File descriptors all admitted transfers may use together.
+         */
+        BatchScheduler(size_t workers, size_t memoryBudget, size_t descriptorBudget);
+
+        /// Queues a transfer of the line-th command, the scheduler takes ownership of args.
+        void Submit(ArgumentParser* args, size_t line);
+
+        /// Runs all queued transfers, @returns Number of failed ones.
+        size_t Run(JobFunction run);
+
+        /// @returns Job counts, run time, queueing delay, peak budget use and peak RSS of the process.
+        std::string Describe() const;
+
+        /// @returns Half of the currently available physical memory.
+        static size_t DefaultMemoryBudget();
+
+        /// @returns Open file limit of the process without DescriptorReserve.
+        static size_t DefaultDescriptorBudget();
+
+        /// @returns Estimated memory of a transfer with the given block size (buffers, socket buffers, decompression),
+        ///          --sessions transfers for a directory mirror.
+        static size_t MemoryCost(const ArgumentParser* args, size_t blockSize);
+
+        /// @returns File descriptors of a transfer (file and the sockets raced on mirror addresses).
+        static size_t DescriptorCost(const ArgumentParser* args);
+
+        /**
+         * @brief Budget admitted to the batch job running on the calling thread, so a directory mirror
+         *        inside a batch schedules its files within it instead of the whole process budget.
+         * @returns False (budgets unchanged) if the thread does not run a batch job.
+         */
+        static bool JobBudget(size_t& memoryBudget, size_t& descriptorBudget);
+
+    private:
+        struct Job
+        {
+            std::unique_ptr<ArgumentParser> Args;
+            size_t Line;
+            size_t EstimatedSize;   //File size for uploads, unknown (SIZE_MAX) for downloads.
+            size_t Memory;          //Budget taken while running.
+            size_t Descriptors;
+        };
+
+        size_t Workers;
+        size_t MemoryBudget;
+        size_t DescriptorBudget;
+
+        //Admission state, guarded by BudgetMutex.
+        std::mutex BudgetMutex;
+        std::condition_variable BudgetChanged;
+        std::vector<Job> Queue;
+        size_t MemoryUsed;
+        size_t DescriptorsUsed;
+        size_t Running;
+
+        //Statistics.
+        Clock::time_point Start;
+        Clock::duration Elapsed;
+        Clock::duration TotalDelay;
+        Clock::duration MaxDelay;
+        size_t Succeeded;
+        size_t Failed;
+        size_t Lowered;         //Jobs admitted with a lowered block size.
+        size_t PeakMemory;
+        size_t PeakRunning;
+
+        static thread_local const Job* CurrentJob;
+
+        void Work(const JobFunction& run);
+
+        /// Waits until the next job fits the budget and takes it from the queue. @returns False when the queue is empty.
+        bool Admit(Job& job);
+
+        void Release(const Job& job, bool succeeded);
+};
@@ -0,0 +1,230 @@
+/**
+ * @brief Streaming decompressor implementation.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "Decompressor.hpp"
+
+//Magic bytes at the start of supported compressed streams.
+constexpr unsigned char gzipMagic[] = { 0x1f, 0x8b };
+constexpr unsigned char zstdMagic[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+Decompressor::Decompressor(OutputFunction output)
+{
+    Output = output;
+    Slots.resize(QueueCapacity);
+    Head = Count = 0;
+    Finished = false;
+    CompressedBytes = DecompressedBytes = 0;
+    PushStall = WorkerStall = std::chrono::steady_clock::duration::zero();
+    Worker = std::thread(&Decompressor::Run, this);
+}
+
+Decompressor::~Decompressor()
+{
+    if (!Worker.joinable())
+        return;
+
+    //Transfer was abandoned, drop queued data and stop the thread.
+    {
+        std::lock_guard<std::mutex> lock(QueueMutex);
+        Finished = true;
+        if (Error.empty())
+            Error = "Decompression cancelled.";
+    }
+    QueueChanged.notify_all();
+    Worker.join();
+}
+
+void Decompressor::Push(std::string_view data)
+{
+    std::unique_lock<std::mutex> lock(QueueMutex);
+    if (Count == QueueCapacity)
+    {
+        auto waitStart = std::chrono::steady_clock::now();
+        QueueChanged.wait(lock, [this]() { return Count < QueueCapacity || !Error.empty(); });
+        PushStall += std::chrono::steady_clock::now() - waitStart;
+    }
+    if (!Error.empty())
+        throw std::runtime_error(Error);
+
+    //Slot keeps its capacity from previous blocks, so steady state does not allocate.
+    Slots[(Head + Count) % QueueCapacity].assign(data.data(), data.size());
+    Count++;
+    CompressedBytes += data.size();
+    QueueChanged.notify_all();
+}
+
+void Decompressor::Finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(QueueMutex);
+        Finished = true;
+    }
+    QueueChanged.notify_all();
+    Worker.join();
+
+    if (!Error.empty())
+        throw std::runtime_error(Error);
+}
+
+bool Decompressor::Pop(std::string& block)
+{
+    std::unique_lock<std::mutex> lock(QueueMutex);
+    auto waitStart = std::chrono::steady_clock::now();
+    QueueChanged.wait(lock, [this]() { return Count > 0 || Finished || !Error.empty(); });
+    WorkerStall += std::chrono::steady_clock::now() - waitStart;
+
+    if (!Error.empty() || Count == 0)
+        return false;
+
+    block.swap(Slots[Head]);
+    Head = (Head + 1) % QueueCapacity;
+    Count--;
+    QueueChanged.notify_all();
+    return true;
+}
+
+void _Write(const Decompressor::OutputFunction& output, const char* data, size_t size, size_t& written)
+{
+    output(data, size);
+    written += size;
+}
+
+//Inflates one block of a gzip stream (concatenated members included), streamEnd is set after a complete member.
+void _Inflate(z_stream& stream, const std::string& block, std::vector<char>& output, const Decompressor::OutputFunction& write, bool& streamEnd, size_t& written)
+{
+    stream.next_in = (Bytef*)block.data();
+    stream.avail_in = block.size();
+    while (stream.avail_in > 0)
+    {
+        if (streamEnd)
+        {
+            inflateReset(&stream);
+            streamEnd = false;
+        }
+        stream.next_out = (Bytef*)output.data();
+        stream.avail_out = output.size();
+
+        auto status = inflate(&stream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR)
+            throw std::runtime_error(std::string("Gzip decompression failed: ") + (stream.msg ? stream.msg : "corrupted data") + ".");
+
+        _Write(write, output.data(), output.size() - stream.avail_out, written);
+        streamEnd = status == Z_STREAM_END;
+    }
+}
+
+#ifdef HAVE_ZSTD
+//Decompresses one block of a zstd stream (concatenated frames included), streamEnd is set after a complete frame.
+void _ZstdDecompress(ZSTD_DStream* stream, const std::string& block, std::vector<char>& output, const Decompressor::OutputFunction& write, bool& streamEnd, size_t& written)
+{
+    ZSTD_inBuffer input = { block.data(), block.size(), 0 };
+    while (input.pos < input.size)
+    {
+        ZSTD_outBuffer out = { output.data(), output.size(), 0 };
+        auto status = ZSTD_decompressStream(stream, &out, &input);
+        if (ZSTD_isError(status))
+            throw std::runtime_error(std::string("Zstd decompression failed: ") + ZSTD_getErrorName(status) + ".");
+
+        _Write(write, output.data(), out.pos, written);
+        streamEnd = status == 0;
+    }
+}
+#endif
+
+void Decompressor::Run()
+{
+    enum { FORMAT_UNKNOWN, FORMAT_GZIP, FORMAT_ZSTD } format = FORMAT_UNKNOWN;
+    std::vector<char> output(OutputBufferSize);
+    std::string block, header;
+    bool streamEnd = false;
+
+    z_stream gzip;
+    memset(&gzip, 0, sizeof(gzip));
+#ifdef HAVE_ZSTD
+    ZSTD_DStream* zstd = NULL;
+#endif
+    try
+    {
+        while (Pop(block))
+        {
+            if (format == FORMAT_UNKNOWN)
+            {
+                //Collect enough bytes to recognize the format (blocks may be as small as 8 B).
+                header += block;
+                if (header.size() < sizeof(zstdMagic))
+                    continue;
+                block.swap(header);
+
+                if (block.size() >= sizeof(gzipMagic) && memcmp(block.data(), gzipMagic, sizeof(gzipMagic)) == 0)
+                {
+                    //Window bits 15 + 16 accept gzip wrapper only.
+                    if (inflateInit2(&gzip, 15 + 16) != Z_OK)
+                        throw std::runtime_error("Could not initialize gzip decompression.");
+                    format = FORMAT_GZIP;
+                }
+                else if (block.size() >= sizeof(zstdMagic) && memcmp(block.data(), zstdMagic, sizeof(zstdMagic)) == 0)
+                {
+#ifdef HAVE_ZSTD
+                    if ((zstd = ZSTD_createDStream()) == NULL)
+                        throw std::runtime_error("Could not initialize zstd decompression.");
+                    format = FORMAT_ZSTD;
+#else
+                    throw std::runtime_error("Received zstd stream, but zstd support is not compiled in.");
+#endif
+                }
+                else throw std::runtime_error("Received data are not a gzip or zstd stream.");
+            }
+            if (format == FORMAT_GZIP)
+                _Inflate(gzip, block, output, Output, streamEnd, DecompressedBytes);
+#ifdef HAVE_ZSTD
+            else
+                _ZstdDecompress(zstd, block, output, Output, streamEnd, DecompressedBytes);
+#endif
+        }
+        std::lock_guard<std::mutex> lock(QueueMutex);
+        if (Error.empty() && !streamEnd)
+            Error = "Compressed stream is incomplete.";
+    }
+    catch (const std::runtime_error& exc)
+    {
+        std::lock_guard<std::mutex> lock(QueueMutex);
+        Error = exc.what();
+    }
+    QueueChanged.notify_all();
+
+    if (format == FORMAT_GZIP)
+        inflateEnd(&gzip);
+#ifdef HAVE_ZSTD
+    ZSTD_freeDStream(zstd);
+#endif
+}
+
+std::string Decompressor::Describe() const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << "Decompressed " << CompressedBytes << " B to " << DecompressedBytes << " B";
+    ss << ", network loop stalled " << std::chrono::duration<double, std::milli>(PushStall).count() << " ms";
+    ss << ", decompression idle " << std::chrono::duration<double, std::milli>(WorkerStall).count() << " ms";
+    return ss.str();
+}
+
+std::string Decompressor::OutputPath(const std::string& path)
+{
+    for (auto suffix : { ".gz", ".zst" })
+    {
+        auto length = strlen(suffix);
+        if (path.size() > length && path.compare(path.size() - length, length, suffix) == 0)
+            return path.substr(0, path.size() - length);
+    }
+    return path;
+}
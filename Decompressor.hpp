@@ -0,0 +1,72 @@
+/**
+ * @brief Streaming decompressor module.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Decompresses a gzip (or zstd, if built with HAVE_ZSTD) stream on a separate thread.
+ *        Received blocks are queued by Push, so the network loop only waits when the queue is full.
+ *        Format is detected from the magic bytes at the start of the stream.
+ */
+class Decompressor
+{
+    public:
+        static constexpr size_t QueueCapacity = 64;     //Blocks buffered between the network loop and the thread.
+        static constexpr size_t OutputBufferSize = 65536;
+
+        /// Decompressed data are passed to the output function, it may throw std::runtime_error.
+        using OutputFunction = std::function<void(const char* data, size_t size)>;
+
+        /// Starts the decompression thread writing through the output function.
+        Decompressor(OutputFunction output);
+        ~Decompressor();
+
+        /**
+         * @brief Queues compressed data, blocks while the queue is full.
+         * @exception std::runtime_error Decompression failed.
+         */
+        void Push(std::string_view data);
+
+        /**
+         * @brief Waits until all queued data are decompressed and written.
+         * @exception std::runtime_error Decompression failed or the stream is incomplete.
+         */
+        void Finish();
+
+        /// @returns Compressed and decompressed byte counts and stall times of both sides of the queue.
+        std::string Describe() const;
+
+        /// @returns File path without a .gz/.zst suffix, path of the decompressed output.
+        static std::string OutputPath(const std::string& path);
+
+    private:
+        OutputFunction Output;
+        std::thread Worker;
+
+        //Ring of reused block buffers, guarded by QueueMutex.
+        std::mutex QueueMutex;
+        std::condition_variable QueueChanged;
+        std::vector<std::string> Slots;
+        size_t Head;
+        size_t Count;
+        bool Finished;      //No more data will be pushed.
+        std::string Error;  //Decompression error, stops the thread.
+
+        //Statistics.
+        size_t CompressedBytes;
+        size_t DecompressedBytes;
+        std::chrono::steady_clock::duration PushStall;   //Network loop waiting for a free slot.
+        std::chrono::steady_clock::duration WorkerStall; //Decompression waiting for data.
+
+        void Run();
+        bool Pop(std::string& block);
+};
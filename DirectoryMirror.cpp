@@ -0,0 +1,311 @@
+/**
+ * @brief Directory mirror implementation.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include "BatchScheduler.hpp"
+#include "DirectoryMirror.hpp"
+#include "Sha256.hpp"
+#include "StampMessagePrinter.hpp"
+#include "Tftp.hpp"
+
+namespace fs = std::filesystem;
+
+//Size and modification time of a regular file, false if it does not exist.
+bool _StatFile(const std::string& path, uint64_t& size, int64_t& modifiedNs)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) == -1 || !S_ISREG(info.st_mode))
+        return false;
+
+    size = info.st_size;
+    modifiedNs = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+    return true;
+}
+
+//Relative path from the file list, without "./", absolute paths and ".." are rejected.
+bool _NormalizePath(std::string& path)
+{
+    while (path.compare(0, 2, "./") == 0)
+        path.erase(0, 2);
+
+    if (path.empty() || path[0] == '/' || path.find_first_of("\t\n") != std::string::npos)
+        return false;
+    for (auto& part : fs::path(path))
+    {
+        if (part == "..")
+            return false;
+    }
+    return true;
+}
+
+DirectoryMirror::DirectoryMirror(ArgumentParser* args)
+{
+    Args = args;
+    Directory = args->MirrorDirectory;
+    Server = std::string(args->WriteMode ? "W" : "R") + "\t" + args->Mirrors[0].AddressStr + "," + std::to_string(args->Mirrors[0].Port);
+    StateModified = false;
+    Files = Hashed = 0;
+    TransferredBytes = 0;
+}
+
+void DirectoryMirror::LoadState()
+{
+    std::ifstream database(Directory + "/" + StateFileName);
+    std::string line;
+
+    //<R|W> <address>,<port> <size> <mtime ns> <sha256> <path>, separated by tabs.
+    while (std::getline(database, line))
+    {
+        std::stringstream fields(line);
+        std::string mode, server, path;
+        FileState state;
+        if (!std::getline(fields, mode, '\t') || !std::getline(fields, server, '\t')
+            || !(fields >> state.Size >> state.ModifiedNs >> state.Digest) || fields.get() != '\t' || !std::getline(fields, path))
+            continue;
+
+        if (mode + "\t" + server == Server)
+            State[path] = state;
+        else
+            OtherServers.push_back(line);
+    }
+}
+
+void DirectoryMirror::SaveState()
+{
+    if (!StateModified)
+        return;
+
+    //Written aside and renamed, an interrupted run keeps the previous database.
+    auto path = Directory + "/" + StateFileName;
+    {
+        std::ofstream database(path + ".tmp", std::ios::trunc);
+        for (auto& line : OtherServers)
+            database << line << "\n";
+        for (auto& [file, state] : State)
+            database << Server << "\t" << state.Size << "\t" << state.ModifiedNs << "\t" << state.Digest << "\t" << file << "\n";
+
+        if (!database.flush())
+            throw std::runtime_error("Could not write mirror state to " + path + ".tmp.");
+    }
+    if (rename((path + ".tmp").c_str(), path.c_str()) == -1)
+        throw std::runtime_error("Could not replace mirror state " + path + ".");
+}
+
+bool DirectoryMirror::IsUnchanged(const std::string& path, const std::string& localPath, FileState& current, const std::string* expectedDigest)
+{
+    if (!_StatFile(localPath, current.Size, current.ModifiedNs))
+        return false;
+
+    //Same size and time as recorded, the recorded digest is trusted without reading the file.
+    auto known = State.find(path);
+    bool sameFile = known != State.end() && known->second.Size == current.Size && known->second.ModifiedNs == current.ModifiedNs;
+    if (sameFile)
+        current.Digest = known->second.Digest;
+    else
+    {
+        current.Digest = Sha256::File(localPath);
+        Hashed++;
+    }
+
+    //Touched but identical files only get their new time recorded.
+    bool unchanged = expectedDigest != NULL ? current.Digest == *expectedDigest
+                                            : known != State.end() && current.Digest == known->second.Digest;
+    if (unchanged && !sameFile)
+    {
+        State[path] = current;
+        StateModified = true;
+    }
+    return unchanged;
+}
+
+void DirectoryMirror::ScanDirectory()
+{
+    //Remote names are the relative paths, under the -d prefix if given.
+    auto prefix = Args->DestinationPath;
+    while (!prefix.empty() && prefix.back() == '/')
+        prefix.pop_back();
+
+    std::set<std::string> present;
+    for (auto& entry : fs::recursive_directory_iterator(Directory, fs::directory_options::skip_permission_denied))
+    {
+        if (!entry.is_regular_file())
+            continue;
+
+        auto path = entry.path().lexically_relative(Directory).generic_string();
+        //State database, its temporary copy (SaveState) and the file list (ReadFileList) are not mirrored.
+        if (path == StateFileName || path == std::string(StateFileName) + ".tmp" || path == std::string(StateFileName) + ".list")
+            continue;
+        if (path.find_first_of("\t\n") != std::string::npos)
+        {
+            StampMessagePrinter::PrintError("Skipping file with a tab or newline in its name: " + path);
+            continue;
+        }
+        Files++;
+        present.insert(path);
+
+        Change change = { path, "", {} };
+        auto localPath = entry.path().string();
+        if (!IsUnchanged(path, localPath, change.State, NULL))
+            Changes[localPath] = change;
+    }
+    //Files deleted from the directory are forgotten (TFTP cannot delete them on the server).
+    for (auto it = State.begin(); it != State.end();)
+    {
+        if (present.count(it->first) == 0)
+        {
+            it = State.erase(it);
+            StateModified = true;
+        }
+        else it++;
+    }
+    for (auto& [localPath, change] : Changes)
+        change.RemotePath = prefix.empty() ? change.Path : prefix + "/" + change.Path;
+}
+
+void DirectoryMirror::ReadFileList()
+{
+    //Download the list next to the state database first.
+    auto listPath = Directory + "/" + StateFileName + ".list";
+    ArgumentParser listArgs(*Args);
+    listArgs.LocalPath = listPath;
+    listArgs.Sparse = false;
+    {
+        Tftp tftp(&listArgs);
+        tftp.Transfer();
+    }
+
+    //Lines of sha256sum output: <digest> <' ' or '*'><path>
+    std::ifstream list(listPath);
+    std::string line;
+    std::set<std::string> listed;
+    while (std::getline(list, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty())
+            continue;
+
+        auto digest = line.substr(0, 64);
+        auto path = line.size() > 66 ? line.substr(66) : "";
+        if (digest.find_first_not_of("0123456789abcdef") != std::string::npos || line.size() <= 66 || line[64] != ' '
+            || (line[65] != ' ' && line[65] != '*') || !_NormalizePath(path))
+        {
+            StampMessagePrinter::PrintError("Skipping invalid file list line: " + line);
+            continue;
+        }
+        if (!listed.insert(path).second)
+            continue;
+        Files++;
+
+        Change change = { path, "", {} };
+        auto localPath = Directory + "/" + path;
+        if (IsUnchanged(path, localPath, change.State, &digest))
+            continue;
+
+        //Downloaded file is recorded with the listed digest, size and time are taken after the transfer.
+        change.State.Digest = digest;
+        change.RemotePath = path;
+        Changes[localPath] = change;
+    }
+    list.close();
+    remove(listPath.c_str());
+
+    for (auto it = State.begin(); it != State.end();)
+    {
+        if (listed.count(it->first) == 0)
+        {
+            it = State.erase(it);
+            StateModified = true;
+        }
+        else it++;
+    }
+}
+
+bool DirectoryMirror::TransferChange(ArgumentParser* args)
+{
+    auto& change = Changes.at(args->LocalPath);
+    StampMessagePrinter::SetThreadPrefix(change.Path + ": ");
+    try
+    {
+        if (args->ReadMode)
+            fs::create_directories(fs::path(args->LocalPath).parent_path());
+        {
+            Tftp tftp(args);
+            tftp.Transfer();
+        }
+        auto state = change.State;
+        if (args->ReadMode)
+        {
+            //Downloaded file must match the list, otherwise it is transferred again next time.
+            if (!_StatFile(args->LocalPath, state.Size, state.ModifiedNs) || Sha256::File(args->LocalPath) != state.Digest)
+                throw std::runtime_error("Downloaded file does not match its digest in the file list.");
+        }
+        std::lock_guard<std::mutex> lock(StateMutex);
+        State[change.Path] = state;
+        StateModified = true;
+        TransferredBytes += state.Size;
+        return true;
+    }
+    catch (const std::runtime_error& exc) //Transfer or file system error, other files go on.
+    {
+        StampMessagePrinter::PrintError(exc.what());
+        return false;
+    }
+}
+
+bool DirectoryMirror::Sync()
+{
+    auto start = std::chrono::steady_clock::now();
+    if (Args->ReadMode)
+        fs::create_directories(Directory);
+    else if (!fs::is_directory(Directory))
+        throw std::runtime_error("Mirror directory " + Directory + " does not exist.");
+
+    LoadState();
+    if (Args->WriteMode)
+        ScanDirectory();
+    else
+        ReadFileList();
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << "Mirror " << Directory << ": " << Files << " files, " << Changes.size() << " changed, " << Hashed << " hashed";
+    ss << ", compared in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms.";
+    StampMessagePrinter::Print(ss.str());
+
+    //Changed files run as a batch, so parallel sessions share one memory and descriptor budget,
+    //the one admitted to this command when it runs in a -j batch itself.
+    size_t failed = 0;
+    if (!Changes.empty())
+    {
+        auto memoryBudget = BatchScheduler::DefaultMemoryBudget(), descriptorBudget = BatchScheduler::DefaultDescriptorBudget();
+        BatchScheduler::JobBudget(memoryBudget, descriptorBudget);
+        BatchScheduler scheduler(Args->Sessions, memoryBudget, descriptorBudget);
+        size_t line = 0;
+        for (auto& [localPath, change] : Changes)
+        {
+            auto args = new ArgumentParser(*Args);
+            args->MirrorDirectory.clear();
+            args->LocalPath = localPath;
+            args->DestinationPath = change.RemotePath;
+            scheduler.Submit(args, ++line);
+        }
+        failed = scheduler.Run([this](ArgumentParser* args) { return TransferChange(args); });
+        StampMessagePrinter::Print(scheduler.Describe());
+    }
+    SaveState();
+
+    ss.str("");
+    ss << "Mirror " << Directory << " synchronized in " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s";
+    ss << ", " << Changes.size() - failed << " files (" << TransferredBytes << " B) transferred, " << failed << " failed.";
+    StampMessagePrinter::Print(ss.str());
+    return failed == 0;
+}
@@ -0,0 +1,73 @@
+/**
+ * @brief Directory mirror module.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ArgumentParser.hpp"
+
+/**
+ * @brief Synchronizes a local directory with the server (argument --mirror), transferring only changed files.
+ *        Write mode uploads files of the directory tree, read mode downloads files of a sha256sum formatted list
+ *        fetched from the server (-d). Path, size, modification time and SHA-256 of transferred files are kept
+ *        in a state database in the directory; a file is hashed only when its size or time differ from it.
+ */
+class DirectoryMirror
+{
+    public:
+        static constexpr const char* StateFileName = ".tftpstate";
+
+        DirectoryMirror(ArgumentParser* args);
+
+        /**
+         * @brief Finds changed files and transfers them in Args->Sessions parallel sessions.
+         * @returns True if all changed files were transferred.
+         * @exception std::runtime_error Directory, file list or state database could not be read.
+         */
+        bool Sync();
+
+    private:
+        struct FileState
+        {
+            uint64_t Size;
+            int64_t ModifiedNs;     //Modification time in nanoseconds since the epoch.
+            std::string Digest;     //SHA-256 in hex.
+        };
+
+        /// File to transfer, keyed by its local path.
+        struct Change
+        {
+            std::string Path;       //Path relative to the directory.
+            std::string RemotePath; //File name requested from the server.
+            FileState State;        //Recorded after a successful transfer (downloads take size and time afterwards).
+        };
+
+        ArgumentParser* Args;
+        std::string Directory;
+        std::string Server;                         //State database key of the server ("R"/"W" and "<address>,<port>").
+
+        std::mutex StateMutex;
+        std::map<std::string, FileState> State;     //Files synchronized with Server, by relative path.
+        std::vector<std::string> OtherServers;      //Database lines of other servers, saved back unchanged.
+        bool StateModified;
+
+        std::map<std::string, Change> Changes;
+        size_t Files;
+        size_t Hashed;
+        uint64_t TransferredBytes;
+
+        void LoadState();
+        void SaveState();
+
+        /// Compares the file with its recorded state, hashing it only if size or time differ. @returns True if unchanged.
+        bool IsUnchanged(const std::string& path, const std::string& localPath, FileState& current, const std::string* expectedDigest);
+
+        void ScanDirectory();
+        void ReadFileList();
+
+        bool TransferChange(ArgumentParser* args);
+};
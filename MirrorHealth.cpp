@@ -0,0 +1,48 @@
+/**
+ * @brief Mirror server health implementation.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#include <algorithm>
+#include "MirrorHealth.hpp"
+
+std::map<std::string, MirrorHealth::Health> MirrorHealth::Servers;
+std::mutex MirrorHealth::ServersMutex;
+
+void MirrorHealth::RecordResponse(const std::string& server, Duration latency)
+{
+    std::lock_guard<std::mutex> lock(ServersMutex);
+    auto& health = Servers[server];
+    auto latencyMs = std::chrono::duration<double, std::milli>(latency).count();
+
+    //Exponentially weighted average, first response sets it directly.
+    if (health.SmoothedLatencyMs == 0)
+        health.SmoothedLatencyMs = latencyMs;
+    else
+        health.SmoothedLatencyMs = 0.75 * health.SmoothedLatencyMs + 0.25 * latencyMs;
+}
+
+void MirrorHealth::RecordSuccess(const std::string& server)
+{
+    std::lock_guard<std::mutex> lock(ServersMutex);
+    Servers[server].ConsecutiveFailures = 0;
+}
+
+void MirrorHealth::RecordFailure(const std::string& server)
+{
+    std::lock_guard<std::mutex> lock(ServersMutex);
+    Servers[server].ConsecutiveFailures++;
+}
+
+double MirrorHealth::Score(const std::string& server)
+{
+    std::lock_guard<std::mutex> lock(ServersMutex);
+    auto& health = Servers[server];
+    return health.SmoothedLatencyMs
+        + std::chrono::duration<double, std::milli>(FailurePenalty).count() * std::min(health.ConsecutiveFailures, MaxPenalty);
+}
+
+MirrorHealth::Duration MirrorHealth::RequestDelay(const std::string& server)
+{
+    std::lock_guard<std::mutex> lock(ServersMutex);
+    return FailurePenalty * std::min(Servers[server].ConsecutiveFailures, MaxPenalty);
+}
@@ -0,0 +1,43 @@
+/**
+ * @brief Mirror server health module.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#pragma once
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Static class keeping health of servers across commands of one program run.
+ *        Servers are identified by "<address>,<port>" as entered in argument -a.
+ */
+class MirrorHealth
+{
+    public:
+        using Duration = std::chrono::steady_clock::duration;
+
+        static constexpr int MaxPenalty = 4;                          //Consecutive failures counted to the request delay.
+        static constexpr std::chrono::milliseconds FailurePenalty { 250 }; //Request delay per consecutive failure.
+
+        static void RecordResponse(const std::string& server, Duration latency);
+        static void RecordSuccess(const std::string& server);
+        static void RecordFailure(const std::string& server);
+
+        /// @returns Health score in milliseconds (smoothed response latency and failure penalty), lower is better.
+        static double Score(const std::string& server);
+
+        /// @returns How long to hold back the request to the server, so healthier mirrors can answer first.
+        static Duration RequestDelay(const std::string& server);
+
+    private:
+        MirrorHealth();
+
+        struct Health
+        {
+            double SmoothedLatencyMs = 0;
+            int    ConsecutiveFailures = 0;
+        };
+        static std::map<std::string, Health> Servers;
+        static std::mutex ServersMutex;
+};
@@ -0,0 +1,122 @@
+/**
+ * @brief Packet pacing implementation.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <time.h>
+#include "Pacer.hpp"
+
+Pacer::Pacer(double rateLimit, bool adaptive, size_t packetSize)
+{
+    RateLimit = rateLimit;
+    Adaptive = adaptive;
+    PacketSize = packetSize;
+
+    Rate = rateLimit;
+    Tokens = packetSize;
+    LastRefill = Clock::now();
+
+    SmoothedRoundTrip = Clock::duration::zero();
+    QueueingRoundTrips = 0;
+    LastSendDelayed = false;
+
+    DelayedSends = 0;
+    TotalTimerError = MaxTimerError = Clock::duration::zero();
+}
+
+void Pacer::Refill(Clock::time_point now)
+{
+    auto elapsed = std::chrono::duration<double>(now - LastRefill).count();
+    auto capacity = std::max(BucketPackets * PacketSize, Rate * std::chrono::duration<double>(BucketTime).count());
+    Tokens = std::min(capacity, Tokens + elapsed * Rate);
+    LastRefill = now;
+}
+
+//Sleep until absolute time of the monotonic clock (steady_clock), resumes after signal interruption.
+void _SleepUntil(Pacer::Clock::time_point wakeUp)
+{
+    auto sinceEpoch = std::chrono::duration_cast<std::chrono::nanoseconds>(wakeUp.time_since_epoch()).count();
+    struct timespec time = { (time_t)(sinceEpoch / 1000000000), (long)(sinceEpoch % 1000000000) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, NULL) != 0);
+}
+
+void Pacer::WaitToSend(size_t packetSize)
+{
+    if (Rate <= 0)
+        return;
+
+    Refill(Clock::now());
+    LastSendDelayed = Tokens < packetSize;
+    if (LastSendDelayed)
+    {
+        //Schedule the send to the moment the missing tokens are refilled.
+        auto missing = std::chrono::duration<double>((packetSize - Tokens) / Rate);
+        auto scheduled = LastRefill + std::chrono::duration_cast<Clock::duration>(missing);
+        _SleepUntil(scheduled);
+
+        auto now = Clock::now();
+        auto error = now - scheduled;
+        TotalTimerError += error;
+        MaxTimerError = std::max(MaxTimerError, error);
+        DelayedSends++;
+        Refill(now);
+    }
+    Tokens -= packetSize;
+}
+
+void Pacer::OnRoundTrip(Clock::duration roundTrip)
+{
+    if (!Adaptive)
+        return;
+
+    //Windowed minimum: samples not below a newer one can never become the minimum, expired ones are dropped.
+    auto now = Clock::now();
+    while (!MinRoundTrips.empty() && MinRoundTrips.back().second >= roundTrip)
+        MinRoundTrips.pop_back();
+    MinRoundTrips.emplace_back(now, roundTrip);
+    while (now - MinRoundTrips.front().first > MinRoundTripWindow)
+        MinRoundTrips.pop_front();
+    auto minRoundTrip = MinRoundTrips.front().second;
+
+    SmoothedRoundTrip = SmoothedRoundTrip == Clock::duration::zero() ? roundTrip : (7 * SmoothedRoundTrip + roundTrip) / 8;
+    auto smoothedSeconds = std::max(std::chrono::duration<double>(SmoothedRoundTrip).count(), 1e-6);
+
+    //Unlimited rate starts at one packet per min RTT, lock-step sending is not slowed until queueing is seen.
+    auto lockStepRate = PacketSize / std::max(std::chrono::duration<double>(minRoundTrip).count(), 1e-6);
+    if (Rate <= 0)
+        Rate = lockStepRate;
+
+    //Each acknowledged packet is one round trip of lock-step TFTP, so single delayed ACKs (jitter) are not queueing.
+    auto queueing = SmoothedRoundTrip > minRoundTrip * DelayThreshold && SmoothedRoundTrip - minRoundTrip > DelayFloor;
+    QueueingRoundTrips = queueing ? QueueingRoundTrips + 1 : 0;
+    if (QueueingRoundTrips >= QueueingPersistence)
+    {
+        Rate *= DecreaseFactor;
+        QueueingRoundTrips = 0;
+    }
+    else if (!queueing && LastSendDelayed)
+        Rate += PacketSize / smoothedSeconds; //Additive increase by one packet per round trip, only if the rate limits sending.
+
+    //Decrease goes below the lock-step rate (spacing sends beyond the RTT), but not to a stall.
+    Rate = std::max(Rate, MinLockStepShare * lockStepRate);
+    if (RateLimit > 0)
+        Rate = std::min(Rate, RateLimit);
+}
+
+std::string Pacer::Describe() const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << "Pacing rate " << Rate / 1000000 << " MB/s";
+    if (RateLimit > 0)
+        ss << " (limit " << RateLimit / 1000000 << " MB/s)";
+    ss << ", " << DelayedSends << " sends delayed";
+    if (DelayedSends > 0)
+    {
+        ss << ", timer error average " << std::chrono::duration<double, std::micro>(TotalTimerError).count() / DelayedSends;
+        ss << " us, max " << std::chrono::duration<double, std::micro>(MaxTimerError).count() << " us";
+    }
+    return ss.str();
+}
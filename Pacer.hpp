@@ -0,0 +1,67 @@
+/**
+ * @brief Packet pacing module.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#pragma once
+#include <chrono>
+#include <deque>
+#include <string>
+
+/**
+ * @brief Spaces outgoing packets with a token bucket, optionally driven by a delay-based AIMD controller.
+ *        Bucket holds the credit of BucketTime at the pacing rate (at least BucketPackets packets), so oversleeps
+ *        of the send timer, including its scheduling latency tail, are made up and the long-run rate matches the
+ *        pacing rate. Lock-step TFTP still sends only one packet per ACK.
+ */
+class Pacer
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr std::chrono::milliseconds BucketTime { 4 }; //Token bucket capacity in time at the pacing rate...
+        static constexpr double BucketPackets = 2;       //... but at least this many packets.
+        static constexpr double DelayThreshold = 1.5;    //Queueing detected when smoothed RTT exceeds min RTT this many times...
+        static constexpr std::chrono::microseconds DelayFloor { 200 }; //... and by at least this much (timer/loopback noise).
+        static constexpr double DecreaseFactor = 0.7;    //Multiplicative decrease of the rate on queueing...
+        static constexpr size_t QueueingPersistence = 8; //... once it lasted this many consecutive round trips.
+        static constexpr std::chrono::seconds MinRoundTripWindow { 10 }; //Min RTT is taken over this window, so it follows route changes.
+        static constexpr double MinLockStepShare = 0.25; //Rate backs off to at least this share of one packet per min RTT.
+
+        /**
+         * @param rateLimit Maximum rate in bytes per second, 0 for unlimited.
+         * @param adaptive Adjust the rate by measured round trips (AIMD), never above rateLimit.
+         * @param packetSize Maximum size of one paced packet.
+         */
+        Pacer(double rateLimit, bool adaptive, size_t packetSize);
+
+        /// Sleeps until a packet of packetSize bytes fits the pacing rate.
+        void WaitToSend(size_t packetSize);
+
+        /// Feeds the round trip of an acknowledged packet to the adaptive controller. Rate starts at one packet
+        /// per min RTT (TFTP lock-step rate) and on queueing backs off below it, down to MinLockStepShare of it.
+        void OnRoundTrip(Clock::duration roundTrip);
+
+        /// @returns Final pacing rate and accuracy of the send timer.
+        std::string Describe() const;
+
+    private:
+        double RateLimit;
+        bool Adaptive;
+        size_t PacketSize;
+
+        double Rate;              //Current pacing rate in B/s, 0 while unlimited.
+        double Tokens;            //Bytes allowed to be sent right now.
+        Clock::time_point LastRefill;
+
+        std::deque<std::pair<Clock::time_point, Clock::duration>> MinRoundTrips; //Window samples, ascending round trips.
+        Clock::duration SmoothedRoundTrip;
+        size_t QueueingRoundTrips; //Consecutive round trips with queueing delay.
+        bool LastSendDelayed;     //Rate is only increased while it is what limits sending.
+
+        //Pacing statistics.
+        size_t DelayedSends;
+        Clock::duration TotalTimerError; //Wake up time after the scheduled send time.
+        Clock::duration MaxTimerError;
+
+        void Refill(Clock::time_point now);
+};
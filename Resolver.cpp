@@ -0,0 +1,84 @@
+/**
+ * @brief Hostname resolver implementation.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#include <netdb.h>
+#include <stdexcept>
+#include <string.h>
+#include "Resolver.hpp"
+
+std::map<std::string, Resolver::CacheEntry> Resolver::Cache;
+std::mutex Resolver::CacheMutex;
+
+//Check if the resolution already finished with an error (such result is not kept in the cache).
+bool _HasFailed(const ResolvedAddresses& result)
+{
+    if (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return false;
+    try
+    {
+        result.get();
+        return false;
+    }
+    catch (const std::exception&)
+    {
+        return true;
+    }
+}
+
+ResolvedAddresses Resolver::ResolveAsync(const std::string& hostname)
+{
+    std::lock_guard<std::mutex> lock(CacheMutex);
+    auto now = std::chrono::steady_clock::now();
+
+    auto cached = Cache.find(hostname);
+    if (cached != Cache.end() && cached->second.Expires > now && !_HasFailed(cached->second.Result))
+        return cached->second.Result;
+
+    //Drop expired entries so the cache stays bounded by names used within the TTL.
+    for (auto it = Cache.begin(); it != Cache.end();)
+    {
+        if (it->second.Expires <= now)
+            it = Cache.erase(it);
+        else
+            it++;
+    }
+    ResolvedAddresses result = std::async(std::launch::async, Resolve, hostname).share();
+    Cache[hostname] = { result, now + CacheTtl };
+    return result;
+}
+
+std::vector<ResolvedAddress> Resolver::Resolve(std::string hostname)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    struct addrinfo* info;
+    int status = getaddrinfo(hostname.c_str(), NULL, &hints, &info);
+    if (status != 0)
+        throw std::runtime_error("Could not resolve hostname " + hostname + ": " + gai_strerror(status));
+
+    std::vector<ResolvedAddress> addresses;
+    for (auto current = info; current != NULL; current = current->ai_next)
+    {
+        ResolvedAddress address;
+        memset(&address, 0, sizeof(address));
+        address.Domain = current->ai_family;
+
+        if (current->ai_family == AF_INET)
+            memcpy(&address.Address.v4, current->ai_addr, sizeof(sockaddr_in));
+        else if (current->ai_family == AF_INET6)
+            memcpy(&address.Address.v6, current->ai_addr, sizeof(sockaddr_in6));
+        else
+            continue;
+
+        addresses.push_back(address);
+    }
+    freeaddrinfo(info);
+
+    if (addresses.empty())
+        throw std::runtime_error("No IPv4 or IPv6 address found for hostname " + hostname + ".");
+    return addresses;
+}
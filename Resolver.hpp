@@ -0,0 +1,59 @@
+/**
+ * @brief Hostname resolver module.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#pragma once
+#include <chrono>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+
+/// Holds either IPv4 or IPv6 struct value.
+union ServerAddress
+{
+    struct sockaddr_in  v4;
+    struct sockaddr_in6 v6;
+};
+
+/// One address of a resolved hostname, port is left unset.
+struct ResolvedAddress
+{
+    union ServerAddress Address;
+    int                 Domain; // AF_INET or AF_INET6
+};
+
+using ResolvedAddresses = std::shared_future<std::vector<ResolvedAddress>>;
+
+/**
+ * @brief Static class resolving hostnames on a background thread.
+ *        Results are kept in a process wide cache for CacheTtl, so repeated lookups
+ *        of the same name (even while the first one is still running) share one getaddrinfo call.
+ */
+class Resolver
+{
+    public:
+        static constexpr std::chrono::seconds CacheTtl { 60 };
+
+        /**
+         * @brief Starts resolution of the hostname or returns a cached one.
+         * @returns Future with IPv6 and IPv4 addresses in getaddrinfo order,
+         *          getting the value throws std::runtime_error if the name cannot be resolved.
+         */
+        static ResolvedAddresses ResolveAsync(const std::string& hostname);
+
+    private:
+        Resolver();
+
+        struct CacheEntry
+        {
+            ResolvedAddresses                     Result;
+            std::chrono::steady_clock::time_point Expires;
+        };
+        static std::map<std::string, CacheEntry> Cache;
+        static std::mutex CacheMutex;
+
+        static std::vector<ResolvedAddress> Resolve(std::string hostname);
+};
@@ -0,0 +1,125 @@
+/**
+ * @brief SHA-256 digest implementation.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <string.h>
+#include <vector>
+#include "Sha256.hpp"
+
+//Round constants, first 32 bits of the fractional parts of cube roots of the first 64 primes.
+constexpr uint32_t roundConstants[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+inline uint32_t _RotateRight(uint32_t value, int bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+Sha256::Sha256()
+{
+    //First 32 bits of the fractional parts of square roots of the first 8 primes.
+    const uint32_t initial[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    memcpy(State, initial, sizeof(State));
+    BlockUsed = 0;
+    TotalBytes = 0;
+}
+
+void Sha256::Compress(const unsigned char* block)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 | (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+    for (int i = 16; i < 64; i++)
+    {
+        auto s0 = _RotateRight(w[i - 15], 7) ^ _RotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        auto s1 = _RotateRight(w[i - 2], 17) ^ _RotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = State[0], b = State[1], c = State[2], d = State[3], e = State[4], f = State[5], g = State[6], h = State[7];
+    for (int i = 0; i < 64; i++)
+    {
+        auto t1 = h + (_RotateRight(e, 6) ^ _RotateRight(e, 11) ^ _RotateRight(e, 25)) + ((e & f) ^ (~e & g)) + roundConstants[i] + w[i];
+        auto t2 = (_RotateRight(a, 2) ^ _RotateRight(a, 13) ^ _RotateRight(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    State[0] += a; State[1] += b; State[2] += c; State[3] += d;
+    State[4] += e; State[5] += f; State[6] += g; State[7] += h;
+}
+
+void Sha256::Update(const void* data, size_t size)
+{
+    auto bytes = (const unsigned char*)data;
+    TotalBytes += size;
+
+    //Complete a partially filled block first, whole blocks are compressed straight from the input.
+    if (BlockUsed > 0)
+    {
+        auto fill = std::min(size, BlockSize - BlockUsed);
+        memcpy(Block + BlockUsed, bytes, fill);
+        BlockUsed += fill;
+        bytes += fill;
+        size -= fill;
+        if (BlockUsed < BlockSize)
+            return;
+        Compress(Block);
+        BlockUsed = 0;
+    }
+    for (; size >= BlockSize; bytes += BlockSize, size -= BlockSize)
+        Compress(bytes);
+
+    memcpy(Block, bytes, size);
+    BlockUsed = size;
+}
+
+std::string Sha256::Final()
+{
+    //Padding: 0x80, zeros up to 56 mod 64, message length in bits (big endian).
+    uint64_t bitLength = TotalBytes * 8;
+    unsigned char padding[BlockSize + 8] = { 0x80 };
+    size_t paddingSize = (BlockUsed < 56 ? 56 : 120) - BlockUsed;
+    for (int i = 0; i < 8; i++)
+        padding[paddingSize + i] = bitLength >> (56 - 8 * i);
+    Update(padding, paddingSize + 8);
+
+    std::string digest;
+    const char hex[] = "0123456789abcdef";
+    for (auto word : State)
+    {
+        for (int shift = 28; shift >= 0; shift -= 4)
+            digest += hex[(word >> shift) & 0xf];
+    }
+    return digest;
+}
+
+std::string Sha256::File(const std::string& path)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+        throw std::runtime_error("Cannot open file " + path + ".");
+
+    Sha256 digest;
+    std::vector<char> buffer(65536);
+    size_t read;
+    while ((read = fread(buffer.data(), 1, buffer.size(), file)) > 0)
+        digest.Update(buffer.data(), read);
+
+    bool failed = ferror(file);
+    fclose(file);
+    if (failed)
+        throw std::runtime_error("Cannot read file " + path + ".");
+    return digest.Final();
+}
@@ -0,0 +1,34 @@
+/**
+ * @brief SHA-256 digest module.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#pragma once
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Incremental SHA-256 (FIPS 180-4), digests are compatible with sha256sum output.
+ */
+class Sha256
+{
+    public:
+        static constexpr size_t BlockSize = 64;
+
+        Sha256();
+
+        void Update(const void* data, size_t size);
+
+        /// @returns Lowercase hex digest of all data passed to Update.
+        std::string Final();
+
+        /// @returns Hex digest of the file content. @exception std::runtime_error File could not be read.
+        static std::string File(const std::string& path);
+
+    private:
+        uint32_t State[8];
+        unsigned char Block[BlockSize];
+        size_t BlockUsed;
+        uint64_t TotalBytes;
+
+        void Compress(const unsigned char* block);
+};
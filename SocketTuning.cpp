@@ -0,0 +1,79 @@
+/**
+ * @brief Socket tuning profile implementation.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include "SocketTuning.hpp"
+#include "TftpCodec.hpp"
+
+//Set integer socket option, privileged variant (ignoring system limits) is tried first if given.
+void _SetIntOption(int socket, int level, int forcedName, int name, int value)
+{
+    if (forcedName != -1 && setsockopt(socket, level, forcedName, &value, sizeof(value)) == 0)
+        return;
+
+    setsockopt(socket, level, name, &value, sizeof(value));
+}
+
+int _GetIntOption(int socket, int level, int name)
+{
+    int value = -1;
+    socklen_t length = sizeof(value);
+    if (getsockopt(socket, level, name, &value, &length) == -1)
+        return -1;
+    return value;
+}
+
+void SocketTuning::Apply(int socket, int domain, size_t blockSize)
+{
+    int bufferSize = (TftpCodec::HeaderSize + blockSize) * InFlightBlocks;
+    _SetIntOption(socket, SOL_SOCKET, SO_RCVBUFFORCE, SO_RCVBUF, bufferSize);
+    _SetIntOption(socket, SOL_SOCKET, SO_SNDBUFFORCE, SO_SNDBUF, bufferSize);
+#ifdef SO_BUSY_POLL
+    _SetIntOption(socket, SOL_SOCKET, -1, SO_BUSY_POLL, BusyPollMicroseconds);
+#endif
+    //DSCP is the upper six bits of the TOS/traffic class octet.
+    if (domain == AF_INET)
+        _SetIntOption(socket, IPPROTO_IP, -1, IP_TOS, LowLatencyDscp << 2);
+    else
+        _SetIntOption(socket, IPPROTO_IPV6, -1, IPV6_TCLASS, LowLatencyDscp << 2);
+}
+
+std::string SocketTuning::Describe(int socket, int domain)
+{
+    std::stringstream ss;
+    ss << "SO_RCVBUF " << _GetIntOption(socket, SOL_SOCKET, SO_RCVBUF) << " B";
+    ss << ", SO_SNDBUF " << _GetIntOption(socket, SOL_SOCKET, SO_SNDBUF) << " B";
+#ifdef SO_BUSY_POLL
+    auto busyPoll = _GetIntOption(socket, SOL_SOCKET, SO_BUSY_POLL);
+    if (busyPoll > 0)
+        ss << ", SO_BUSY_POLL " << busyPoll << " us";
+    else
+        ss << ", SO_BUSY_POLL off (not permitted)";
+#endif
+    auto tos = domain == AF_INET ? _GetIntOption(socket, IPPROTO_IP, IP_TOS)
+                                 : _GetIntOption(socket, IPPROTO_IPV6, IPV6_TCLASS);
+    ss << ", DSCP " << (tos == -1 ? -1 : tos >> 2);
+    return ss.str();
+}
+
+void SocketTuning::PinThread(int cpu, cpu_set_t& previous)
+{
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &previous) == -1)
+        throw std::runtime_error("Could not get CPU affinity of the transfer thread.");
+
+    cpu_set_t pinned;
+    CPU_ZERO(&pinned);
+    CPU_SET(cpu, &pinned);
+    if (sched_setaffinity(0, sizeof(cpu_set_t), &pinned) == -1)
+        throw std::runtime_error("Could not pin the transfer thread to CPU " + std::to_string(cpu) + ".");
+}
+
+void SocketTuning::RestoreThread(const cpu_set_t& previous)
+{
+    sched_setaffinity(0, sizeof(cpu_set_t), &previous);
+}
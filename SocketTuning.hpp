@@ -0,0 +1,37 @@
+/**
+ * @brief Socket tuning profile module.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#pragma once
+#include <sched.h>
+#include <string>
+
+/**
+ * @brief Static class applying the low-latency tuning profile (argument -p lowlatency) to a socket.
+ *        Settings the process is not permitted to change are skipped, Describe shows what took effect.
+ */
+class SocketTuning
+{
+    public:
+        static constexpr size_t InFlightBlocks = 16;     //Blocks the socket buffers hold (bursts, duplicates).
+        static constexpr int BusyPollMicroseconds = 50;  //SO_BUSY_POLL time of a blocking receive.
+        static constexpr int LowLatencyDscp = 46;        //Expedited Forwarding (RFC 3246).
+
+        /// Sizes socket buffers for blockSize data packets, enables busy polling and sets the DSCP class.
+        static void Apply(int socket, int domain, size_t blockSize);
+
+        /// @returns Socket settings in effect, as read back from the kernel.
+        static std::string Describe(int socket, int domain);
+
+        /**
+         * @brief Pins the calling thread to the CPU.
+         * @param previous Affinity of the thread before pinning, for RestoreThread.
+         * @exception std::runtime_error
+         */
+        static void PinThread(int cpu, cpu_set_t& previous);
+
+        static void RestoreThread(const cpu_set_t& previous);
+
+    private:
+        SocketTuning();
+};
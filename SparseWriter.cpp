@@ -0,0 +1,115 @@
+/**
+ * @brief Sparse file writer implementation.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "SparseWriter.hpp"
+
+SparseWriter::SparseWriter(FILE* file)
+{
+    //Anything buffered by stdio has to reach the file before writing to the descriptor directly.
+    fflush(file);
+    Descriptor = fileno(file);
+    Offset = lseek(Descriptor, 0, SEEK_CUR);
+    WrittenBytes = 0;
+}
+
+bool SparseWriter::IsZero(const char* data, size_t size)
+{
+    size_t i = 0;
+#ifdef __SSE2__
+    //OR four 16 B vectors together, one compare per 64 B.
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 64 <= size; i += 64)
+    {
+        auto a = _mm_loadu_si128((const __m128i*)(data + i));
+        auto b = _mm_loadu_si128((const __m128i*)(data + i + 16));
+        auto c = _mm_loadu_si128((const __m128i*)(data + i + 32));
+        auto d = _mm_loadu_si128((const __m128i*)(data + i + 48));
+        auto any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(any, zero)) != 0xFFFF)
+            return false;
+    }
+#endif
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        if (word != 0)
+            return false;
+    }
+    for (; i < size; i++)
+    {
+        if (data[i] != 0)
+            return false;
+    }
+    return true;
+}
+
+void SparseWriter::WriteRun(const char* data, size_t size, off_t offset)
+{
+    while (size > 0)
+    {
+        auto written = pwrite(Descriptor, data, size, offset);
+        if (written == -1)
+            throw std::runtime_error("Could not write to file.");
+
+        data += written;
+        offset += written;
+        size -= written;
+        WrittenBytes += written;
+    }
+}
+
+void SparseWriter::Write(const char* data, size_t size)
+{
+    //Split data at file page boundaries, neighbouring non-zero pieces are written at once.
+    const char* run = NULL;
+    off_t runOffset = 0;
+    while (size > 0)
+    {
+        auto pieceSize = std::min<size_t>(size, PageSize - Offset % PageSize);
+        if (IsZero(data, pieceSize))
+        {
+            if (run != NULL)
+                WriteRun(run, data - run, runOffset);
+            run = NULL;
+        }
+        else if (run == NULL)
+        {
+            run = data;
+            runOffset = Offset;
+        }
+        data += pieceSize;
+        Offset += pieceSize;
+        size -= pieceSize;
+    }
+    if (run != NULL)
+        WriteRun(run, data - run, runOffset);
+}
+
+void SparseWriter::Finish()
+{
+    if (ftruncate(Descriptor, Offset) == -1 || lseek(Descriptor, Offset, SEEK_SET) == -1)
+        throw std::runtime_error("Could not set file size.");
+}
+
+std::string SparseWriter::Describe() const
+{
+    std::stringstream ss;
+    ss << "Sparse file of " << Offset << " B, written " << WrittenBytes << " B";
+
+    struct stat info;
+    if (fstat(Descriptor, &info) == 0)
+        ss << ", allocated " << info.st_blocks * 512 << " B";
+    return ss.str();
+}
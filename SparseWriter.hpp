@@ -0,0 +1,40 @@
+/**
+ * @brief Sparse file writer module.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#pragma once
+#include <cstdio>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * @brief Writes sequential data to an empty file, leaving all-zero pages as holes.
+ *        File gets its full length by Finish, skipped ranges read back as zeros.
+ */
+class SparseWriter
+{
+    public:
+        static constexpr size_t PageSize = 4096; //Hole granularity, zero ranges are checked per file page.
+
+        /// Writer continues at the current position of the (empty) open file.
+        SparseWriter(FILE* file);
+
+        /// Writes data after the previous ones. @exception std::runtime_error
+        void Write(const char* data, size_t size);
+
+        /// Extends the file to its logical size, trailing zeros are never written. @exception std::runtime_error
+        void Finish();
+
+        /// @returns Logical size, bytes actually written and space allocated on disk.
+        std::string Describe() const;
+
+        /// @returns True if all bytes are zero, tests 64 B per step with SSE2 where available.
+        static bool IsZero(const char* data, size_t size);
+
+    private:
+        int Descriptor;
+        off_t Offset;        //Logical size written so far.
+        size_t WrittenBytes; //Bytes that were not skipped.
+
+        void WriteRun(const char* data, size_t size, off_t offset);
+};
@@ -7,6 +7,14 @@
 #include <iostream>
 #include "StampMessagePrinter.hpp"
 
+std::mutex StampMessagePrinter::StreamMutex;
+thread_local std::string StampMessagePrinter::ThreadPrefix;
+
+void StampMessagePrinter::SetThreadPrefix(std::string prefix)
+{
+    ThreadPrefix = prefix;
+}
+
 void StampMessagePrinter::Print(std::string message)
 {
     PrintWithTimeStamp(message, std::cout);
@@ -21,11 +29,14 @@ void StampMessagePrinter::PrintWithTimeStamp(std::string message, std::ostream&
 {
     auto now = std::chrono::system_clock::now();
     auto time = std::chrono::system_clock::to_time_t(now);
+    struct tm localTime;
+    localtime_r(&time, &localTime);
 
-    //[YYYY-MM-DD hh:mm:ss.uu] message
+    //[YYYY-MM-DD hh:mm:ss.uu] prefix message, one line at a time from concurrent transfers.
+    std::lock_guard<std::mutex> lock(StreamMutex);
     stream << "[" 
-        << std::put_time(std::localtime(&time), "%F %T") << "." << std::setfill('0') << std::setw(3)
+        << std::put_time(&localTime, "%F %T") << "." << std::setfill('0') << std::setw(3)
         << std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000
         << "] " 
-        << message << std::endl;
+        << ThreadPrefix << message << std::endl;
 }
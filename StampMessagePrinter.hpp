@@ -3,6 +3,7 @@
  * @author Tomáš Milostný (xmilos02)
  */
 #pragma once
+#include <mutex>
 #include <string>
 
 class StampMessagePrinter
@@ -10,8 +11,12 @@ class StampMessagePrinter
 public:
     static void Print(std::string message);
     static void PrintError(std::string message);
+    //Set text printed before messages of the calling thread (identifies concurrent transfers).
+    static void SetThreadPrefix(std::string prefix);
 private:
     StampMessagePrinter();
+    static std::mutex StreamMutex;
+    static thread_local std::string ThreadPrefix;
     //Print local time with miliseconds and message.
     static void PrintWithTimeStamp(std::string message, std::ostream& stream);
 };
@@ -2,34 +2,39 @@
  * @brief TFTP class implementation.
  * @author Tomáš Milostný (xmilos02)
  */
+#include <algorithm>
 #include <iomanip>
+#include <memory>
+#include <poll.h>
 #include <unistd.h>
 #include <stdexcept>
 #include <string.h>
+#include "Decompressor.hpp"
+#include "MirrorHealth.hpp"
+#include "Pacer.hpp"
+#include "SocketTuning.hpp"
+#include "SparseWriter.hpp"
 #include "StampMessagePrinter.hpp"
 #include "Tftp.hpp"
+#include "TftpCodec.hpp"
 
-//TFTP protocol packet opcodes.
-#define OPCODE_RRQ      1
-#define OPCODE_WRQ      2
-#define OPCODE_DATA     3
-#define OPCODE_ACK      4
-#define OPCODE_ERROR    5
+//Happy Eyeballs delay before the request is also sent to the other address family (RFC 8305).
+constexpr std::chrono::milliseconds connectionAttemptDelay { 250 };
 
 //Tftp class wide socket shortcut macros.
 #define SEND(buffer, size)      sendto(ClientSocket, buffer, size, 0, (sockaddr*)&Args->ServerAddress, SocketLength)
 #define RECEIVE(buffer, size)   recvfrom(ClientSocket, buffer, size, 0, (sockaddr*)&Args->ServerAddress, &SocketLength)
 
-//Request packet option constants.
-const char* blksizeReqOptStr = "blksize";
-const char* timeoutReqOptStr = "timeout";
-const char* tsizeReqOptStr = "tsize";
-
 Tftp::Tftp(ArgumentParser* args)
 {
     Args = args;
     ClientSocket = -1;
+    CurrentMirror = -1;
     DestinationFile = NULL;
+    Pinned = false;
+    TransferredBytes = 0;
+    RoundTripTime = std::chrono::steady_clock::duration::zero();
+    RoundTrips = 0;
 }
 
 Tftp::~Tftp()
@@ -39,6 +44,9 @@ Tftp::~Tftp()
 
     if (ClientSocket != -1)
         close(ClientSocket);
+
+    if (Pinned)
+        SocketTuning::RestoreThread(PreviousAffinity);
 }
 
 void _OpenFile(FILE*& file, ArgumentParser* args, char fopenMode)
@@ -48,260 +56,566 @@ void _OpenFile(FILE*& file, ArgumentParser* args, char fopenMode)
     if (args->TransferMode == "octet")
         fileMode[1] = 'b';
 
-    if ((file = fopen(args->DestinationPath.c_str(), fileMode)) == NULL)
-        throw std::runtime_error("Cannot open file" + args->DestinationPath + ".");
+    //Decompressed download is written without the compression suffix.
+    auto path = args->Decompress ? Decompressor::OutputPath(args->LocalPath) : args->LocalPath;
+    if ((file = fopen(path.c_str(), fileMode)) == NULL)
+        throw std::runtime_error("Cannot open file" + path + ".");
 }
 
-void Tftp::Transfer()
+//Server identification for MirrorHealth.
+std::string _MirrorKey(const ServerMirror& mirror)
 {
-    //Create socket.
-    if ((ClientSocket = socket(Args->Domain, SOCK_DGRAM, 0)) == -1)
+    return mirror.AddressStr + "," + std::to_string(mirror.Port);
+}
+
+int _CreateSocket(ArgumentParser* args, int domain)
+{
+    int clientSocket;
+    if ((clientSocket = socket(domain, SOCK_DGRAM, 0)) == -1)
     {
         throw std::runtime_error("Could not create socket.");
     }
-    SocketLength = Args->Domain == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
+    if (args->Profile == "lowlatency")
+        SocketTuning::Apply(clientSocket, domain, args->Size);
 
-    //Set ClientSocket timeout.
-    if (Args->Timeout > 0)
+    //Set socket timeout.
+    if (args->Timeout > 0)
     {
-        struct timeval timeValue = { Args->Timeout, 0 };
-        if (setsockopt(ClientSocket, SOL_SOCKET, SO_RCVTIMEO, &timeValue, sizeof(timeValue)) == -1)
+        struct timeval timeValue = { args->Timeout, 0 };
+        if (setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, &timeValue, sizeof(timeValue)) == -1)
         {
+            close(clientSocket);
             throw std::runtime_error("Could not set socket timeout.");
         }
     }
+    return clientSocket;
+}
+
+void Tftp::Transfer()
+{
+    //Pin the transfer to a CPU, previous affinity is restored by destructor.
+    if (Args->Cpu != -1)
+    {
+        SocketTuning::PinThread(Args->Cpu, PreviousAffinity);
+        Pinned = true;
+    }
     //Open file if it is going to be read on the client side (WRQ).
     if (Args->WriteMode)
         _OpenFile(DestinationFile, Args, 'r');
 
-    //Get total file size from server response.
-    size_t totalSize = Request();
+    auto requestedSize = Args->Size;
+    FailedMirrors.assign(Args->Mirrors.size(), false);
+    while (true)
+    {
+        try
+        {
+            //Get total file size from server response.
+            CurrentMirror = -1;
+            size_t totalSize = Request();
 
-    //Open file if it is going to be written to the server side (RRQ).
-    if (Args->ReadMode)
-        _OpenFile(DestinationFile, Args, 'w');
+            //Open file if it is going to be written to the server side (RRQ).
+            if (Args->ReadMode)
+                _OpenFile(DestinationFile, Args, 'w');
 
-    //Transfer file.
-    if (Args->ReadMode)
-        ReceiveData(totalSize);
-    else
-        SendData(totalSize);
+            //Transfer file.
+            auto start = std::chrono::steady_clock::now();
+            if (Args->ReadMode)
+                ReceiveData(totalSize);
+            else
+                SendData(totalSize);
+
+            MirrorHealth::RecordSuccess(_MirrorKey(Args->Mirrors[CurrentMirror]));
+            PrintStatistics(std::chrono::steady_clock::now() - start);
+            return;
+        }
+        catch (const ServerError& exc)
+        {
+            //No server answered the request (their failures are recorded) or the only one failed.
+            if (CurrentMirror == -1)
+                throw;
+
+            MirrorHealth::RecordFailure(_MirrorKey(Args->Mirrors[CurrentMirror]));
+            FailedMirrors[CurrentMirror] = true;
+            if (std::all_of(FailedMirrors.begin(), FailedMirrors.end(), [](bool failed) { return failed; }))
+                throw;
+
+            //Fail over to the remaining mirrors, download starts again from the beginning.
+            //Server messages come without a full stop, separate them from the failover note.
+            std::string message = exc.what();
+            if (!message.empty() && message.back() != '.')
+                message += '.';
+            StampMessagePrinter::PrintError(message + " Failing over to another server.");
+            close(ClientSocket);
+            ClientSocket = -1;
+            if (DestinationFile != NULL)
+            {
+                fclose(DestinationFile);
+                DestinationFile = NULL;
+            }
+            PendingBlock.clear();
+            Args->Size = requestedSize;
+            TransferredBytes = RoundTrips = 0;
+            RoundTripTime = std::chrono::steady_clock::duration::zero();
+        }
+    }
 }
 
-std::string _GetTransferSize(FILE* file, bool isWriteMode)
+void Tftp::PrintStatistics(std::chrono::steady_clock::duration duration)
 {
-    if (isWriteMode)
+    auto seconds = std::chrono::duration<double>(duration).count();
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << "Transferred " << TransferredBytes << " B in " << seconds * 1000 << " ms";
+    if (seconds > 0)
+        ss << " (" << TransferredBytes / seconds / 1000000 << " MB/s)";
+    if (RoundTrips > 0)
     {
-        fseek(file, 0, SEEK_END);
-        auto fSizeAsString = std::to_string(ftell(file));
-        rewind(file);
-        return fSizeAsString;
+        auto average = std::chrono::duration<double, std::micro>(RoundTripTime).count() / RoundTrips;
+        ss << ", average block round trip " << average << " us";
+    }
+    ss << ".";
+    StampMessagePrinter::Print(ss.str());
+}
+
+std::vector<RequestAttempt> Tftp::ServerCandidates()
+{
+    std::vector<RequestAttempt> attempts;
+    for (size_t i = 0; i < Args->Mirrors.size(); i++)
+    {
+        auto& mirror = Args->Mirrors[i];
+        if (FailedMirrors[i])
+            continue;
+
+        std::vector<ResolvedAddress> resolved = { { mirror.ServerAddress, mirror.Domain } };
+        if (!mirror.Hostname.empty())
+        {
+            //Wait for the resolution started by the argument parser, unresolvable mirrors are skipped.
+            try
+            {
+                resolved = mirror.Resolution.get();
+            }
+            catch (const std::runtime_error& exc)
+            {
+                if (Args->Mirrors.size() == 1)
+                    throw;
+                StampMessagePrinter::PrintError(exc.what());
+                MirrorHealth::RecordFailure(_MirrorKey(mirror));
+                FailedMirrors[i] = true;
+                continue;
+            }
+        }
+        //Keep the first address of each family, the preferred family first.
+        //Racing a WRQ would start two uploads of the same file on a dual-stack server,
+        //so the other family is tried only after the first one timed out.
+        auto delay = MirrorHealth::RequestDelay(_MirrorKey(mirror));
+        auto familyDelay = Args->ReadMode ? std::chrono::steady_clock::duration(connectionAttemptDelay)
+                                          : std::chrono::steady_clock::duration(std::chrono::seconds(Args->Timeout));
+        auto first = attempts.size();
+        bool addedV4 = false, addedV6 = false;
+        for (auto& address : resolved)
+        {
+            auto& added = address.Domain == AF_INET ? addedV4 : addedV6;
+            if (added)
+                continue;
+            added = true;
+
+            attempts.push_back({ address, i, delay + familyDelay * (attempts.size() - first) });
+            if (address.Domain == AF_INET)
+                attempts.back().Address.Address.v4.sin_port = htons(mirror.Port);
+            else
+                attempts.back().Address.Address.v6.sin6_port = htons(mirror.Port);
+        }
+        //Without a timeout only the preferred address is ever tried for WRQ.
+        if (Args->WriteMode && Args->Timeout == 0)
+            attempts.resize(first + 1);
     }
-    return "0";
+    if (attempts.empty())
+        throw ServerError("None of the servers could be resolved.");
+
+    std::stable_sort(attempts.begin(), attempts.end(), [](auto& a, auto& b) { return a.Delay < b.Delay; });
+    return attempts;
 }
 
-void _CopyOpcodeToPacket(char* packetPtr, uint16_t opcode)
+//Reply to a server which answered the request too late with an error, so it does not wait for a timeout.
+void _CancelRequest(int clientSocket)
 {
-    opcode = htons(opcode);
-    memcpy(packetPtr, &opcode, sizeof(uint16_t));
+    char buffer[TftpCodec::MaxRequestSize];
+    union ServerAddress from;
+    socklen_t fromLength = sizeof(from);
+    if (recvfrom(clientSocket, buffer, sizeof(buffer), MSG_DONTWAIT, (sockaddr*)&from, &fromLength) > 0)
+    {
+        auto errorSize = TftpCodec::EncodeError(buffer, sizeof(buffer), 0, "Transfer cancelled, another server answered first.");
+        sendto(clientSocket, buffer, errorSize, 0, (sockaddr*)&from, fromLength);
+    }
+    close(clientSocket);
 }
 
-size_t Tftp::Request()
+int Tftp::SendRequest(const char* packet, size_t packetSize, char* response, size_t responseSize)
 {
-    std::stringstream ss;
-    ss << "Requesting " << (Args->ReadMode ? "READ from" : "WRITE to");
-    ss << " server " << Args->AddressStr << " on port " << Args->Port << ".";
-    StampMessagePrinter::Print(ss.str());
+    auto attempts = ServerCandidates();
+
     /*
-    2 bytes     string     1 byte     string   1 byte
-    --------------------------------------------------
-    | Opcode |  Filename  |   0  |    Mode    |   0  | + NULL teminated options/values
-    --------------------------------------------------
-                Figure 5-1: RRQ/WRQ packet
+    Request is sent to all mirrors at once, the first server to answer is kept.
+    Happy Eyeballs (RFC 8305): within one server, the preferred address family goes first,
+    the other family gets the same request after connectionAttemptDelay unless
+    the first one has answered already. Mirrors that failed recently are held back.
     */
-    //Load options values.
-    auto tsizeValStr = _GetTransferSize(DestinationFile, Args->WriteMode);
-    auto timeoutValStr = std::to_string(Args->Timeout);
-    auto blksizeValStr = std::to_string(Args->Size);
-    
-    //Store options sizes for memory allocation and logic if option is in the packet.
-    int tsizeOptSize = (Args->TransferMode == "octet") * (strlen(tsizeReqOptStr) + tsizeValStr.size() + 2);
-    int timeoutOptSize = (Args->Timeout != 0) * (strlen(timeoutReqOptStr) + timeoutValStr.size() + 2);
-    int blksizeOptSize = (Args->Size != 512) * (strlen(blksizeReqOptStr) + blksizeValStr.size() + 2);
-
-    int optionsSize = tsizeOptSize + timeoutOptSize + blksizeOptSize;
-    
-    //Allocate dynamically sized packet (without unnecessary options).
-    auto packetSize = 4 + Args->DestinationPath.size() + Args->TransferMode.size() + optionsSize;
-    auto packetPtr = (char*)calloc(packetSize, sizeof(char));
-    if (packetPtr == NULL)
+    std::vector<struct pollfd> sockets(attempts.size(), { -1, POLLIN, 0 });
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start;
+    size_t sent = 0;
+    int winner = -1;
+    while (winner == -1)
     {
-        throw std::runtime_error("Could not allocate memory for request packet.");
+        //Start all attempts which are due, socket of a family unsupported by the system is skipped.
+        auto now = std::chrono::steady_clock::now();
+        for (; sent < attempts.size() && start + attempts[sent].Delay <= now; sent++)
+        {
+            if (Args->WriteMode)
+            {
+                for (size_t i = 0; i < sent; i++)
+                {
+                    if (sockets[i].fd != -1)
+                        close(sockets[i].fd);
+                    sockets[i].fd = -1;
+                }
+            }
+            auto& address = attempts[sent].Address;
+            auto addressLength = address.Domain == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
+            try
+            {
+                sockets[sent].fd = _CreateSocket(Args, address.Domain);
+            }
+            catch (const std::runtime_error&)
+            {
+                continue;
+            }
+            if (sendto(sockets[sent].fd, packet, packetSize, 0, (sockaddr*)&address.Address, addressLength) == -1)
+            {
+                //Unreachable address, poll ignores negative descriptors.
+                close(sockets[sent].fd);
+                sockets[sent].fd = -1;
+            }
+            deadline = now + std::chrono::seconds(Args->Timeout);
+        }
+        auto lastAttempt = sent == attempts.size();
+        auto pending = std::any_of(sockets.begin(), sockets.begin() + sent, [](auto& s) { return s.fd != -1; });
+        if (!pending && lastAttempt)
+            break;
+        if (!pending)
+        {
+            //Nothing to wait for, start the next attempt right away.
+            start = now - attempts[sent].Delay;
+            continue;
+        }
+        int waitMs = -1;
+        if (!lastAttempt)
+            waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(start + attempts[sent].Delay - now).count() + 1;
+        else if (Args->Timeout > 0)
+            waitMs = std::max(0L, (long)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
+
+        int ready = poll(sockets.data(), sent, waitMs);
+        if ((ready == -1 && errno != EINTR) || (ready == 0 && lastAttempt))
+            break;
+
+        for (size_t i = 0; i < sent && ready > 0 && winner == -1; i++)
+        {
+            if (sockets[i].revents & POLLIN)
+                winner = i;
+            else if (sockets[i].revents & POLLERR)
+            {
+                close(sockets[i].fd);
+                sockets[i].fd = -1;
+            }
+        }
     }
-    _CopyOpcodeToPacket(packetPtr, Args->ReadMode ? OPCODE_RRQ : OPCODE_WRQ);
-    
-    //Pointer for copying values to the addresses in packet.
-    auto currentPtr = packetPtr + 2;
-    
-    strcpy(currentPtr, Args->DestinationPath.c_str());
-    currentPtr += 1 + Args->DestinationPath.size();
-
-    strcpy(currentPtr, Args->TransferMode.c_str());
-    currentPtr += 1 + Args->TransferMode.size();
-
-    if (tsizeOptSize)
+    //Cancel requests to the slower servers and address families.
+    for (size_t i = 0; i < sockets.size(); i++)
     {
-        strcpy(currentPtr, tsizeReqOptStr);
-        currentPtr += 1 + strlen(tsizeReqOptStr);
-        strcpy(currentPtr, tsizeValStr.c_str());
-        currentPtr += 1 + tsizeValStr.size();
+        if ((int)i != winner && sockets[i].fd != -1)
+            _CancelRequest(sockets[i].fd);
     }
-    if (timeoutOptSize)
+    if (winner == -1)
     {
-        strcpy(currentPtr, timeoutReqOptStr);
-        currentPtr += 1 + strlen(timeoutReqOptStr);
-        strcpy(currentPtr, timeoutValStr.c_str());
-        currentPtr += 1 + timeoutValStr.size();
+        for (size_t i = 0; i < sent; i++)
+            MirrorHealth::RecordFailure(_MirrorKey(Args->Mirrors[attempts[i].Mirror]));
+        throw ServerError("Server did not respond.");
     }
-    if (blksizeOptSize)
+    auto latency = std::chrono::steady_clock::now() - (start + attempts[winner].Delay);
+    CurrentMirror = attempts[winner].Mirror;
+    MirrorHealth::RecordResponse(_MirrorKey(Args->Mirrors[CurrentMirror]), latency);
+
+    Args->SelectMirror(CurrentMirror);
+    ClientSocket = sockets[winner].fd;
+    Args->Domain = attempts[winner].Address.Domain;
+    Args->ServerAddress = attempts[winner].Address.Address;
+    SocketLength = Args->Domain == AF_INET ? sizeof(sockaddr_in) : sizeof(sockaddr_in6);
+
+    if (Args->Profile == "lowlatency")
+        StampMessagePrinter::Print("Socket tuning (lowlatency): " + SocketTuning::Describe(ClientSocket, Args->Domain) + ".");
+
+    if (!Args->Hostname.empty() || Args->Mirrors.size() > 1)
     {
-        strcpy(currentPtr, blksizeReqOptStr);
-        currentPtr += 1 + strlen(blksizeReqOptStr);
-        strcpy(currentPtr, blksizeValStr.c_str());
+        char addressStr[INET6_ADDRSTRLEN];
+        if (Args->Domain == AF_INET)
+            inet_ntop(AF_INET, &Args->ServerAddress.v4.sin_addr, addressStr, sizeof(addressStr));
+        else
+            inet_ntop(AF_INET6, &Args->ServerAddress.v6.sin6_addr, addressStr, sizeof(addressStr));
+
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(3);
+        ss << "Server " << Args->AddressStr << " on port " << Args->Port << " answered from " << addressStr;
+        ss << " in " << std::chrono::duration<double, std::milli>(latency).count() << " ms";
+        if (Args->Mirrors.size() > 1)
+            ss << " (health score " << MirrorHealth::Score(_MirrorKey(Args->Mirrors[CurrentMirror])) << ")";
+        ss << ".";
+        StampMessagePrinter::Print(ss.str());
     }
-    SEND(packetPtr, packetSize);
-    free(packetPtr);
+    return RECEIVE(response, responseSize);
+}
 
-    auto bufferSize = 42 + optionsSize;
-    auto responseBuffer = (char*)calloc(bufferSize, sizeof(char));
-    if (responseBuffer == NULL)
+size_t _GetTransferSize(FILE* file, bool isWriteMode)
+{
+    if (isWriteMode)
     {
-        throw std::runtime_error("Could not allocate memory for response buffer.");
+        fseek(file, 0, SEEK_END);
+        size_t fSize = ftell(file);
+        rewind(file);
+        return fSize;
     }
-    auto received = RECEIVE(responseBuffer, bufferSize);
+    return 0;
+}
+
+//Throws the message from the server if the packet is an ERROR packet.
+void _ThrowIfError(std::string_view packet)
+{
+    uint16_t errorCode;
+    std::string_view message;
+    if (TftpCodec::ParseError(packet, errorCode, message))
+    {
+        throw ServerError("Error from the server:  " + std::string(message));
+    }
+}
+
+size_t Tftp::Request()
+{
+    std::stringstream ss;
+    ss << "Requesting " << (Args->ReadMode ? "READ from" : "WRITE to");
+    auto mirrorsLeft = std::count(FailedMirrors.begin(), FailedMirrors.end(), false);
+    if (mirrorsLeft > 1)
+        ss << " " << mirrorsLeft << " servers.";
+    else
+    {
+        //After failover the remaining candidate is not the first mirror (Args->AddressStr).
+        auto& mirror = Args->Mirrors[std::find(FailedMirrors.begin(), FailedMirrors.end(), false) - FailedMirrors.begin()];
+        ss << " server " << mirror.AddressStr << " on port " << mirror.Port << ".";
+    }
+    StampMessagePrinter::Print(ss.str());
+
+    //Load options values, options with default values are left out of the packet.
+    TftpOptions requestOptions;
+    if (Args->TransferMode == "octet")
+        requestOptions.Set(OPTION_TSIZE, _GetTransferSize(DestinationFile, Args->WriteMode));
+    if (Args->Timeout != 0)
+        requestOptions.Set(OPTION_TIMEOUT, Args->Timeout);
+    if (Args->Size != 512)
+        requestOptions.Set(OPTION_BLKSIZE, Args->Size);
+
+    char packet[TftpCodec::MaxRequestSize];
+    auto packetSize = TftpCodec::EncodeRequest(packet, sizeof(packet), Args->ReadMode ? OPCODE_RRQ : OPCODE_WRQ,
+                                               Args->DestinationPath, Args->TransferMode, requestOptions);
+
+    //Response is an OACK or the first DATA/ACK packet of a server without option support.
+    char responseBuffer[TftpCodec::HeaderSize + 512];
+    auto received = SendRequest(packet, packetSize, responseBuffer, sizeof(responseBuffer));
     if (received == -1)
     {
-        free(responseBuffer);
-        throw std::runtime_error("Server did not respond.");
+        throw ServerError("Server did not respond.");
     }
+    std::string_view response(responseBuffer, received);
+
     //Received an error packet, display message from server and end with error.
-    if (ntohs(*(uint16_t*)responseBuffer) == OPCODE_ERROR)
+    _ThrowIfError(response);
+
+    TftpOptions responseOptions;
+    switch (TftpCodec::ParseOpcode(response))
     {
-        /*
-        2 bytes     2 bytes      string    1 byte
-        -------------------------------------------
-        | Opcode |  ErrorCode |   ErrMsg   |   0  |
-        -------------------------------------------
-                Figure 5-4: ERROR packet
-        */
-        auto message = "Error from the server:  " + std::string(responseBuffer + 4);
-        free(responseBuffer);
-        throw std::runtime_error(message);
+    case OPCODE_OACK:
+        if (!TftpCodec::ParseOack(response, responseOptions))
+            throw ServerError("Received malformed OACK packet.");
+        break;
+    case OPCODE_DATA:
+        if (Args->ReadMode)
+        {
+            //Keep the first block for ReceiveData, it would not be sent again.
+            PendingBlock.assign(response.data(), response.size());
+            break;
+        }
+        throw ServerError("Unexpected response from the server.");
+    case OPCODE_ACK:
+        if (Args->WriteMode)
+            break;
+        [[fallthrough]];
+    default:
+        throw ServerError("Unexpected response from the server.");
     }
-    size_t tsizeFromResponse;
-    //Received an OACK packet, read tsize option from it if transfer mode is octet.
-    if (Args->TransferMode == "octet")
+    //Server may only lower the block size, missing option means it was declined.
+    if (responseOptions.Has(OPTION_BLKSIZE))
     {
-        //Get tsize option from the response packet (useful for reading from the server).
-        std::string responseTsize = responseBuffer + 3 + strlen(tsizeReqOptStr);
-        tsizeFromResponse = std::stoul(responseTsize);
+        if (responseOptions.Get(OPTION_BLKSIZE) > Args->Size)
+            throw ServerError("Server responded with a bigger block size than requested.");
+        Args->Size = responseOptions.Get(OPTION_BLKSIZE);
     }
-    else tsizeFromResponse = std::stoul(tsizeValStr);
-    free(responseBuffer);
-    return tsizeFromResponse;
+    else Args->Size = 512;
+
+    //Upload length is always the local file size (tsize is not sent in netascii, the server's echo is not trusted).
+    if (Args->WriteMode)
+        return _GetTransferSize(DestinationFile, true);
+
+    //Get tsize option from the response packet (size of the file to download, 0 if unknown).
+    return responseOptions.Has(OPTION_TSIZE) ? responseOptions.Get(OPTION_TSIZE) : 0;
 }
 
 void Tftp::SendData(size_t totalFileSize)
 {
     size_t totalSent = 0;
     size_t blockN = 0;
+
+    //Allocate packet buffer once, last chunk of data is sent with smaller length.
+    std::vector<char> packet(TftpCodec::HeaderSize + Args->Size);
+    auto packetPtr = packet.data();
+    Pacer pacer(Args->Rate, Args->Adaptive, TftpCodec::HeaderSize + Args->Size);
+
     //Send data packets to the server while the whole file is not read.
     while (totalSent < totalFileSize)
     {
-        /*
-        2 bytes     2 bytes      n bytes
-        ------------------------------------
-        | Opcode |   Block #  |   Data     |
-        ------------------------------------
-            Figure 5-2: DATA packet
-        */
         //Increment block number, mark total send.
         blockN++;
         size_t totalToSend = totalSent + Args->Size <= totalFileSize ? Args->Size : totalFileSize - totalSent;
+        auto packetSize = TftpCodec::HeaderSize + totalToSend;
 
-        //Create packet with dynamic length (smaller for the last chunk of data).
-        auto packetSize = 4 + totalToSend;
-        auto packetPtr = (char*)calloc(packetSize, sizeof(char));
-        if (packetPtr == NULL)
-        {
-            throw std::runtime_error("Could not allocate memory for data packet.");
-        }
         totalSent += totalToSend;
         std::stringstream ss;
         ss << "Sending DATA #" << blockN <<" ... " << totalSent << " B of " << totalFileSize << " B.";
         StampMessagePrinter::Print(ss.str());
 
-        //Fill in packet header.
-        _CopyOpcodeToPacket(packetPtr, OPCODE_DATA);
-        blockN = htons(blockN);
-        memcpy(packetPtr + 2, &blockN, sizeof(uint16_t));
-        blockN = ntohs(blockN);
-
-        //Read data from file and send them.
-        fread(packetPtr + 4, sizeof(char), totalToSend, DestinationFile);
+        //Fill in packet header, read data from file and send them.
+        TftpCodec::EncodeDataHeader(packetPtr, blockN);
+        if (fread(packetPtr + TftpCodec::HeaderSize, sizeof(char), totalToSend, DestinationFile) != totalToSend)
+            throw std::runtime_error("Could not read from file.");
+        pacer.WaitToSend(packetSize);
         int sendResult;
         do
         {
             sendResult = SEND(packetPtr, packetSize);
         }
         while (sendResult == -1);
-        free(packetPtr);
+        auto sentAt = std::chrono::steady_clock::now();
 
-        //Check received acknowledgement.
-        char ackBuffer[4];
-        auto received = RECEIVE(ackBuffer, 4);
-        if (received == -1 || ntohs(*(uint16_t*)ackBuffer) != OPCODE_ACK)
+        //Check received acknowledgement, skip duplicate ACKs of previous blocks.
+        char ackBuffer[TftpCodec::MaxErrorSize];
+        uint16_t ackBlockN;
+        do
         {
-            throw std::runtime_error("Error while transfering data.");
+            auto received = RECEIVE(ackBuffer, sizeof(ackBuffer));
+            std::string_view ack(ackBuffer, received == -1 ? 0 : received);
+
+            if (!TftpCodec::ParseAck(ack, ackBlockN))
+            {
+                _ThrowIfError(ack);
+                throw ServerError("Error while transfering data.");
+            }
         }
-    } 
+        while (ackBlockN != (uint16_t)blockN);
+
+        auto roundTrip = std::chrono::steady_clock::now() - sentAt;
+        pacer.OnRoundTrip(roundTrip);
+        RoundTripTime += roundTrip;
+        RoundTrips++;
+        TransferredBytes = totalSent;
+    }
+
+    if (Args->Rate > 0 || Args->Adaptive)
+        StampMessagePrinter::Print(pacer.Describe() + ".");
 }
 
 void Tftp::ReceiveData(size_t totalFileSize)
 {
     size_t blockN = 0;
     size_t totalReceived = 0;
-    /*
-    2 bytes     2 bytes      n bytes
-    ------------------------------------
-    | Opcode |   Block #  |   Data     |
-    ------------------------------------
-        Figure 5-2: DATA packet
-    */
-    size_t bufferSize = 4 + Args->Size;
-    auto buffer = (char*)malloc(bufferSize);
-    if (buffer == NULL)
+
+    size_t bufferSize = TftpCodec::HeaderSize + Args->Size;
+    std::vector<char> buffer(bufferSize);
+    //Downloads are paced by delaying ACKs, server sends next block only after it gets one.
+    Pacer pacer(Args->Rate, Args->Adaptive, bufferSize);
+
+    //Zero pages are skipped by the sparse writer instead of written.
+    std::unique_ptr<SparseWriter> sparseWriter;
+    if (Args->Sparse)
+        sparseWriter = std::make_unique<SparseWriter>(DestinationFile);
+
+    auto writeData = [&](const char* data, size_t size)
     {
-        throw std::runtime_error("Could not allocate memory for data buffer.");
-    }
-    int received;
-    do
+        if (sparseWriter)
+            sparseWriter->Write(data, size);
+        else if (fwrite(data, sizeof(char), size, DestinationFile) != size)
+            throw std::runtime_error("Could not write to file.");
+    };
+    //Decompression runs on its own thread, so receiving and ACKing continues meanwhile.
+    std::unique_ptr<Decompressor> decompressor;
+    if (Args->Decompress)
+        decompressor = std::make_unique<Decompressor>(writeData);
+
+    int received = 0;
+    bool lastBlock = false;
+    while (!lastBlock)
     {
-        SendAcknowledgment(blockN++);
-        memset(buffer, 0, bufferSize);
-        
-        if ((received = RECEIVE(buffer, bufferSize)) == -1)
+        if (!PendingBlock.empty())
         {
-            free(buffer);
-            throw std::runtime_error("Lost connection to the server.");
+            //Server without option support answered the request directly with the first block.
+            blockN++;
+            received = PendingBlock.size();
+            memcpy(buffer.data(), PendingBlock.data(), received);
+            PendingBlock.clear();
         }
-        if (ntohs(((uint16_t*)buffer)[1]) != blockN)
+        else
+        {
+            //Previous block is accounted for before the ACK that requests the next one.
+            pacer.WaitToSend(received);
+            SendAcknowledgment(blockN++);
+            auto ackSentAt = std::chrono::steady_clock::now();
+
+            if ((received = RECEIVE(buffer.data(), bufferSize)) == -1)
+                throw ServerError("Lost connection to the server.");
+
+            auto roundTrip = std::chrono::steady_clock::now() - ackSentAt;
+            pacer.OnRoundTrip(roundTrip);
+            RoundTripTime += roundTrip;
+            RoundTrips++;
+        }
+        std::string_view packet(buffer.data(), received);
+        uint16_t packetBlockN;
+        std::string_view data;
+        if (!TftpCodec::ParseData(packet, packetBlockN, data))
+        {
+            if (TftpCodec::ParseOpcode(packet) == OPCODE_ERROR)
+            {
+                _ThrowIfError(packet);
+                throw ServerError("Received malformed ERROR packet.");
+            }
+            //Not a DATA packet, ACK the last block again and keep receiving.
+            blockN--;
+            continue;
+        }
+        if (packetBlockN != (uint16_t)blockN)
         {
             blockN--;
             continue;
         }
-        auto dataLength = received - 4;
-        totalReceived += dataLength;
+        //Only an accepted block can end the transfer, a short stray packet must not.
+        lastBlock = received < (int)bufferSize;
+        totalReceived += data.size();
+        TransferredBytes = totalReceived;
 
         std::stringstream ss;
         ss << "Received DATA #" << blockN << " ... " << totalReceived << " B";
@@ -311,31 +625,40 @@ void Tftp::ReceiveData(size_t totalFileSize)
             ss << '.';
         StampMessagePrinter::Print(ss.str());
 
-        fwrite(buffer + 4, sizeof(char), dataLength, DestinationFile);
+        if (decompressor)
+            decompressor->Push(data);
+        else
+            writeData(data.data(), data.size());
     }
-    while (received == (int)bufferSize);
-
     SendAcknowledgment(blockN);
-    free(buffer);
+
+    //Size announced by the tsize option has to match, otherwise the file is truncated.
+    if (totalFileSize > 0 && totalReceived != totalFileSize)
+        throw ServerError("Received " + std::to_string(totalReceived) + " B, but the server announced " + std::to_string(totalFileSize) + " B.");
+
+    if (decompressor)
+    {
+        decompressor->Finish();
+        StampMessagePrinter::Print(decompressor->Describe() + ".");
+    }
+    if (sparseWriter)
+    {
+        sparseWriter->Finish();
+        StampMessagePrinter::Print(sparseWriter->Describe() + ".");
+    }
+
+    if (Args->Rate > 0 || Args->Adaptive)
+        StampMessagePrinter::Print(pacer.Describe() + ".");
 }
 
 void Tftp::SendAcknowledgment(uint16_t blockN)
 {
-    /*
-    2 bytes     2 bytes
-    -----------------------
-    | Opcode |   Block #  |
-    -----------------------
-    Figure 5-3: ACK packet
-    */
-    char packetPtr[4];
-    _CopyOpcodeToPacket(packetPtr, OPCODE_ACK);
-    blockN = htons(blockN);
-    memcpy(packetPtr + 2, &blockN, sizeof(uint16_t));
+    char packetPtr[TftpCodec::HeaderSize];
+    TftpCodec::EncodeAck(packetPtr, blockN);
     int sendResult;
     do
     {
-        sendResult = SEND(packetPtr, 4);
+        sendResult = SEND(packetPtr, sizeof(packetPtr));
     }
     while (sendResult == -1);
 }
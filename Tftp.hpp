@@ -3,8 +3,27 @@
  * @author Tomáš Milostný (xmilos02)
  */
 #pragma once
+#include <chrono>
+#include <sched.h>
+#include <stdexcept>
+#include <vector>
 #include "ArgumentParser.hpp"
 
+/// Failure caused by the server (no response, ERROR packet, protocol violation), another mirror may be tried.
+class ServerError : public std::runtime_error
+{
+    public:
+        using std::runtime_error::runtime_error;
+};
+
+/// Request to one address of a server from argument -a.
+struct RequestAttempt
+{
+    ResolvedAddress Address;
+    size_t Mirror;                              //Index into ArgumentParser::Mirrors.
+    std::chrono::steady_clock::duration Delay;  //Time from the start of the race to sending the request.
+};
+
 /**
  * @brief Class for TFTP communication controlled by ArgumentParser attributes.
  */
@@ -25,16 +44,42 @@ class Tftp
         FILE* DestinationFile;         //Open destination file.
         int ClientSocket;     //Socket file descriptor used for communication.
         socklen_t SocketLength;
+        std::string PendingBlock;     //First DATA packet, if the server answered RRQ without OACK.
+        int CurrentMirror;            //Index of the server in Args->Mirrors which answered the request, -1 before.
+        std::vector<bool> FailedMirrors; //Mirrors excluded from failover.
+        bool Pinned;                  //Transfer thread is pinned to Args->Cpu.
+        cpu_set_t PreviousAffinity;   //Affinity to restore after pinned transfer.
+
+        //Transfer statistics.
+        size_t TransferredBytes;
+        std::chrono::steady_clock::duration RoundTripTime; //Total time from DATA/ACK sent to the answer received.
+        size_t RoundTrips;
 
         /**
          * @brief Creates and sends a RRQ/WRQ request packet based on Destination and Read/Write mode attrributes from args parameter.
-         * @returns tsize option (returned from server for Read request), aka total count of data bytes. -1 on error.
+         *        Negotiated block size from the server response is stored back to args.
+         * @returns tsize option (returned from server for Read request), aka total count of data bytes.
+         * @exception std::runtime_error
          */
         size_t Request();
 
+        /// @returns Addresses of mirrors that did not fail yet to race the request on, at most one per address family.
+        std::vector<RequestAttempt> ServerCandidates();
+
+        /**
+         * @brief Sends the request packet to the server candidates and receives the first response.
+         *        Socket of the first server to answer is kept as ClientSocket and the server is selected in Args.
+         * @returns Size of the response.
+         * @exception ServerError No server answered.
+         */
+        int SendRequest(const char* packet, size_t packetSize, char* response, size_t responseSize);
+
         void SendData(size_t totalFileSize);
 
         void ReceiveData(size_t totalFileSize);
 
         void SendAcknowledgment(uint16_t blockN);
+
+        /// Prints transferred bytes, goodput and average block round trip time.
+        void PrintStatistics(std::chrono::steady_clock::duration duration);
 };
@@ -0,0 +1,235 @@
+/**
+ * @brief TFTP packet codec implementation.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#include <arpa/inet.h>
+#include <charconv>
+#include <stdexcept>
+#include <string.h>
+#include "TftpCodec.hpp"
+
+//Longest decimal representation of an option value (UINT64_MAX).
+constexpr size_t maxOptionValueLength = 20;
+
+//Longest encoded options part of a request, computed from the option table.
+constexpr size_t _MaxOptionsSize()
+{
+    size_t size = 0;
+    for (auto& option : TftpOptionTable)
+        size += option.Name.size() + 1 + maxOptionValueLength + 1;
+    return size;
+}
+//All options have to fit into a request together with a reasonably long file name.
+static_assert(TftpCodec::HeaderSize + _MaxOptionsSize() < TftpCodec::MaxRequestSize / 2);
+
+void _WriteUint16(char* buffer, uint16_t value)
+{
+    value = htons(value);
+    memcpy(buffer, &value, sizeof(uint16_t));
+}
+
+uint16_t _ReadUint16(const char* buffer)
+{
+    uint16_t value;
+    memcpy(&value, buffer, sizeof(uint16_t));
+    return ntohs(value);
+}
+
+//Copies a zero terminated string to the buffer, moving the current pointer after it.
+void _WriteString(char*& current, const char* end, std::string_view str)
+{
+    if (str.size() + 1 > (size_t)(end - current))
+        throw std::runtime_error("Request packet exceeds maximum size of " + std::to_string(TftpCodec::MaxRequestSize) + " B.");
+
+    memcpy(current, str.data(), str.size());
+    current += str.size();
+    *current++ = '\0';
+}
+
+//Reads a zero terminated string from packet starting at position, moving position after the terminator.
+bool _ReadString(std::string_view packet, size_t& position, std::string_view& str)
+{
+    auto terminator = packet.find('\0', position);
+    if (terminator == std::string_view::npos)
+        return false;
+
+    str = packet.substr(position, terminator - position);
+    position = terminator + 1;
+    return true;
+}
+
+//Case folding by bit 5 is exact here, as option names in TftpOptionTable are letters only (strncasecmp goes through the locale).
+bool _EqualsIgnoreCase(std::string_view a, std::string_view b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if ((a[i] | 0x20) != (b[i] | 0x20))
+            return false;
+    }
+    return true;
+}
+
+size_t TftpCodec::EncodeRequest(char* buffer, size_t bufferSize, uint16_t opcode,
+                                std::string_view filename, std::string_view mode, const TftpOptions& options)
+{
+    /*
+    2 bytes     string     1 byte     string   1 byte
+    --------------------------------------------------
+    | Opcode |  Filename  |   0  |    Mode    |   0  | + NULL teminated options/values
+    --------------------------------------------------
+                Figure 5-1: RRQ/WRQ packet
+    */
+    if (bufferSize < sizeof(uint16_t))
+        throw std::runtime_error("Request packet buffer is too small.");
+
+    _WriteUint16(buffer, opcode);
+    auto current = buffer + sizeof(uint16_t);
+    auto end = buffer + bufferSize;
+
+    _WriteString(current, end, filename);
+    _WriteString(current, end, mode);
+
+    for (size_t i = 0; i < OPTION_COUNT; i++)
+    {
+        if (!options.Present[i])
+            continue;
+
+        char valueStr[maxOptionValueLength];
+        auto result = std::to_chars(valueStr, valueStr + sizeof(valueStr), options.Values[i]);
+
+        _WriteString(current, end, TftpOptionTable[i].Name);
+        _WriteString(current, end, std::string_view(valueStr, result.ptr - valueStr));
+    }
+    return current - buffer;
+}
+
+size_t TftpCodec::EncodeDataHeader(char* buffer, uint16_t blockN)
+{
+    /*
+    2 bytes     2 bytes      n bytes
+    ------------------------------------
+    | Opcode |   Block #  |   Data     |
+    ------------------------------------
+        Figure 5-2: DATA packet
+    */
+    _WriteUint16(buffer, OPCODE_DATA);
+    _WriteUint16(buffer + 2, blockN);
+    return HeaderSize;
+}
+
+size_t TftpCodec::EncodeAck(char* buffer, uint16_t blockN)
+{
+    /*
+    2 bytes     2 bytes
+    -----------------------
+    | Opcode |   Block #  |
+    -----------------------
+    Figure 5-3: ACK packet
+    */
+    _WriteUint16(buffer, OPCODE_ACK);
+    _WriteUint16(buffer + 2, blockN);
+    return HeaderSize;
+}
+
+size_t TftpCodec::EncodeError(char* buffer, size_t bufferSize, uint16_t errorCode, std::string_view message)
+{
+    /*
+    2 bytes     2 bytes      string    1 byte
+    -------------------------------------------
+    | Opcode |  ErrorCode |   ErrMsg   |   0  |
+    -------------------------------------------
+            Figure 5-4: ERROR packet
+    */
+    if (bufferSize <= HeaderSize)
+        throw std::runtime_error("Error packet buffer is too small.");
+
+    _WriteUint16(buffer, OPCODE_ERROR);
+    _WriteUint16(buffer + 2, errorCode);
+
+    message = message.substr(0, bufferSize - HeaderSize - 1);
+    memcpy(buffer + HeaderSize, message.data(), message.size());
+    buffer[HeaderSize + message.size()] = '\0';
+    return HeaderSize + message.size() + 1;
+}
+
+uint16_t TftpCodec::ParseOpcode(std::string_view packet)
+{
+    if (packet.size() < sizeof(uint16_t))
+        return 0;
+
+    return _ReadUint16(packet.data());
+}
+
+bool TftpCodec::ParseOack(std::string_view packet, TftpOptions& options)
+{
+    /*
+    2 bytes    string    1 byte   string   1 byte
+    ---------------------------------------------- ...
+    | Opcode |  opt1  |    0   |  value1  |   0  |
+    ---------------------------------------------- ...
+                    OACK packet (RFC 2347)
+    */
+    if (ParseOpcode(packet) != OPCODE_OACK)
+        return false;
+
+    options = TftpOptions();
+    size_t position = sizeof(uint16_t);
+
+    while (position < packet.size())
+    {
+        std::string_view name, value;
+        if (!_ReadString(packet, position, name) || !_ReadString(packet, position, value))
+            return false;
+
+        for (size_t i = 0; i < OPTION_COUNT; i++)
+        {
+            if (!_EqualsIgnoreCase(name, TftpOptionTable[i].Name))
+                continue;
+
+            uint64_t number;
+            auto result = std::from_chars(value.data(), value.data() + value.size(), number);
+            if (value.empty() || result.ec != std::errc() || result.ptr != value.data() + value.size()
+                || number < TftpOptionTable[i].Min || number > TftpOptionTable[i].Max)
+            {
+                return false;
+            }
+            options.Set((TftpOption)i, number);
+            break;
+        }
+    }
+    return true;
+}
+
+bool TftpCodec::ParseError(std::string_view packet, uint16_t& errorCode, std::string_view& message)
+{
+    if (packet.size() < HeaderSize || ParseOpcode(packet) != OPCODE_ERROR)
+        return false;
+
+    errorCode = _ReadUint16(packet.data() + 2);
+
+    //Be lenient about a missing terminator, the message is only displayed.
+    message = packet.substr(HeaderSize);
+    message = message.substr(0, message.find('\0'));
+    return true;
+}
+
+bool TftpCodec::ParseData(std::string_view packet, uint16_t& blockN, std::string_view& data)
+{
+    if (packet.size() < HeaderSize || ParseOpcode(packet) != OPCODE_DATA)
+        return false;
+
+    blockN = _ReadUint16(packet.data() + 2);
+    data = packet.substr(HeaderSize);
+    return true;
+}
+
+bool TftpCodec::ParseAck(std::string_view packet, uint16_t& blockN)
+{
+    if (packet.size() < HeaderSize || ParseOpcode(packet) != OPCODE_ACK)
+        return false;
+
+    blockN = _ReadUint16(packet.data() + 2);
+    return true;
+}
@@ -0,0 +1,97 @@
+/**
+ * @brief TFTP packet codec module.
+ * @author Tomáš Milostný (xmilos02)
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+//TFTP protocol packet opcodes (RFC 1350, RFC 2347).
+constexpr uint16_t OPCODE_RRQ   = 1;
+constexpr uint16_t OPCODE_WRQ   = 2;
+constexpr uint16_t OPCODE_DATA  = 3;
+constexpr uint16_t OPCODE_ACK   = 4;
+constexpr uint16_t OPCODE_ERROR = 5;
+constexpr uint16_t OPCODE_OACK  = 6;
+
+/// Request options supported by the client, index into TftpOptionTable.
+enum TftpOption
+{
+    OPTION_TSIZE,   // RFC 2349
+    OPTION_TIMEOUT, // RFC 2349
+    OPTION_BLKSIZE, // RFC 2348
+    OPTION_COUNT
+};
+
+/// Compile-time description of a request option: its name and the range of valid values.
+struct TftpOptionInfo
+{
+    std::string_view Name;
+    uint64_t         Min;
+    uint64_t         Max;
+};
+
+constexpr TftpOptionInfo TftpOptionTable[OPTION_COUNT] =
+{
+    { "tsize",   0, UINT64_MAX },
+    { "timeout", 1, 255 },
+    { "blksize", 8, 65464 },
+};
+
+/// Option values of a request or an OACK packet, options are included only if they are set.
+struct TftpOptions
+{
+    uint64_t Values[OPTION_COUNT] = {};
+    bool     Present[OPTION_COUNT] = {};
+
+    void Set(TftpOption option, uint64_t value) { Values[option] = value; Present[option] = true; }
+    bool Has(TftpOption option) const           { return Present[option]; }
+    uint64_t Get(TftpOption option) const       { return Values[option]; }
+};
+
+/**
+ * @brief Static class encoding TFTP packets into caller provided buffers
+ *        and parsing received packets without copying (views point into the received buffer).
+ *        Parse methods return false on a malformed or truncated packet instead of throwing.
+ */
+class TftpCodec
+{
+    public:
+        static constexpr size_t HeaderSize = 4;       //Opcode + block number/error code.
+        static constexpr size_t MaxRequestSize = 512; //Request and OACK packet size limit (RFC 2347).
+        static constexpr size_t MaxErrorSize = 512;
+
+        /**
+         * @brief Encodes a RRQ/WRQ packet with the options that are set.
+         * @returns Size of the encoded packet.
+         * @exception std::runtime_error Packet does not fit into the buffer.
+         */
+        static size_t EncodeRequest(char* buffer, size_t bufferSize, uint16_t opcode,
+                                    std::string_view filename, std::string_view mode, const TftpOptions& options);
+
+        /// Encodes a DATA packet header, data are expected right after it. @returns HeaderSize.
+        static size_t EncodeDataHeader(char* buffer, uint16_t blockN);
+
+        /// Encodes an ACK packet into a buffer of at least HeaderSize bytes. @returns HeaderSize.
+        static size_t EncodeAck(char* buffer, uint16_t blockN);
+
+        /// Encodes an ERROR packet, message is truncated to fit the buffer. @returns Size of the encoded packet.
+        static size_t EncodeError(char* buffer, size_t bufferSize, uint16_t errorCode, std::string_view message);
+
+        /// @returns Opcode of the packet or 0 if the packet is too short.
+        static uint16_t ParseOpcode(std::string_view packet);
+
+        /// Parses an OACK packet. Options may be in any order, names are case insensitive and unknown ones are skipped.
+        static bool ParseOack(std::string_view packet, TftpOptions& options);
+
+        /// Parses an ERROR packet, message view excludes the terminating zero byte.
+        static bool ParseError(std::string_view packet, uint16_t& errorCode, std::string_view& message);
+
+        static bool ParseData(std::string_view packet, uint16_t& blockN, std::string_view& data);
+
+        static bool ParseAck(std::string_view packet, uint16_t& blockN);
+
+    private:
+        TftpCodec();
+};
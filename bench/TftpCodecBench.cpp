@@ -0,0 +1,90 @@
+/**
+ * @brief Microbenchmark of the TFTP packet codec against the former request/OACK code (make bench).
+ * @author Tomáš Milostný (xmilos02)
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <arpa/inet.h>
+#include "../TftpCodec.hpp"
+
+constexpr size_t iterations = 2000000;
+
+//Keeps results alive, so the compiler cannot drop the measured work.
+static volatile uint64_t sink;
+
+//Former Tftp::Request: calloc of an exactly sized packet, strcpy of every field, option values by std::to_string.
+static void _LegacyEncodeRequest(const std::string& filename, const std::string& mode, size_t tsize, int timeout, size_t blksize)
+{
+    auto tsizeValStr = std::to_string(tsize);
+    auto timeoutValStr = std::to_string(timeout);
+    auto blksizeValStr = std::to_string(blksize);
+    int optionsSize = (strlen("tsize") + tsizeValStr.size() + 2) + (strlen("timeout") + timeoutValStr.size() + 2)
+                    + (strlen("blksize") + blksizeValStr.size() + 2);
+
+    auto packetSize = 4 + filename.size() + mode.size() + optionsSize;
+    auto packetPtr = (char*)calloc(packetSize, sizeof(char));
+    uint16_t opcode = htons(OPCODE_RRQ);
+    memcpy(packetPtr, &opcode, sizeof(opcode));
+
+    auto currentPtr = packetPtr + 2;
+    for (auto field : { filename.c_str(), mode.c_str(), "tsize", tsizeValStr.c_str(), "timeout", timeoutValStr.c_str(),
+                        "blksize", blksizeValStr.c_str() })
+    {
+        strcpy(currentPtr, field);
+        currentPtr += 1 + strlen(field);
+    }
+    sink = sink + packetPtr[packetSize / 2];
+    free(packetPtr);
+}
+
+//Former OACK handling: tsize value read at a fixed offset, assuming it is the first option.
+static void _LegacyParseOack(const char* packet, size_t packetSize)
+{
+    auto responseBuffer = (char*)calloc(packetSize + 1, sizeof(char));
+    memcpy(responseBuffer, packet, packetSize);
+    std::string responseTsize = responseBuffer + 3 + strlen("tsize");
+    sink = sink + std::stoul(responseTsize);
+    free(responseBuffer);
+}
+
+template<typename Function>
+static double _NanosecondsPerCall(Function function)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+        function();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+int main()
+{
+    const std::string filename = "images/boot/vmlinuz-6.1.0-amd64", mode = "octet";
+    TftpOptions options;
+    options.Set(OPTION_TSIZE, 7340032);
+    options.Set(OPTION_TIMEOUT, 3);
+    options.Set(OPTION_BLKSIZE, 1428);
+
+    char request[TftpCodec::MaxRequestSize];
+    auto encode = _NanosecondsPerCall([&]() {
+        auto size = TftpCodec::EncodeRequest(request, sizeof(request), OPCODE_RRQ, filename, mode, options);
+        sink = sink + request[size / 2];
+    });
+    auto legacyEncode = _NanosecondsPerCall([&]() { _LegacyEncodeRequest(filename, mode, 7340032, 3, 1428); });
+
+    //OACK with tsize first, the only layout the former code understood.
+    static const char oack[] = "\0\6tsize\0" "7340032\0timeout\0" "3\0blksize\0" "1428";
+    auto parse = _NanosecondsPerCall([&]() {
+        TftpOptions parsed;
+        TftpCodec::ParseOack(std::string_view(oack, sizeof(oack)), parsed);
+        sink = sink + parsed.Get(OPTION_TSIZE);
+    });
+    auto legacyParse = _NanosecondsPerCall([&]() { _LegacyParseOack(oack, sizeof(oack)); });
+
+    printf("%-28s %10s %10s %8s\n", "operation", "codec ns", "former ns", "speedup");
+    printf("%-28s %10.1f %10.1f %7.2fx\n", "EncodeRequest (3 options)", encode, legacyEncode, legacyEncode / encode);
+    printf("%-28s %10.1f %10.1f %7.2fx\n", "ParseOack (3 options)", parse, legacyParse, legacyParse / parse);
+    return 0;
+}
@@ -0,0 +1,133 @@
+#!/bin/bash
+# Loopback benchmark of mytftpclient (make bench-loopback): goodput and block round trip of the socket
+# profiles and pacing modes, each downloading and uploading a random file from bench/loopback_server.py.
+# The sparse set downloads a mostly zero image with --sparse and -z --sparse, checking it against the reference
+# byte by byte and that it allocates less than its logical size.
+# Usage: bench/loopback.sh [profiles|pacing|sparse|all]
+# Environment: SIZE_MB (file size, 16), BLOCK (-s, 8192), RUNS (runs per case, median reported, 3), PORT (6990),
+#              DELAY_US (server reply delay with +-50 % jitter emulating a slower path, 0).
+# Author: Tomáš Milostný (xmilos02)
+
+SET=${1:-all}
+SIZE_MB=${SIZE_MB:-16}
+BLOCK=${BLOCK:-8192}
+RUNS=${RUNS:-3}
+PORT=${PORT:-6990}
+DELAY_US=${DELAY_US:-0}
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+CLIENT="$ROOT/mytftpclient"
+if [ ! -x "$CLIENT" ]; then
+    echo "Build mytftpclient first (make)." >&2
+    exit 1
+fi
+
+# Label and mytftpclient arguments of each case.
+CASES=()
+if [ "$SET" = profiles ] || [ "$SET" = all ]; then
+    CASES+=("-p default|-p default" "-p lowlatency|-p lowlatency" "-p lowlatency,0|-p lowlatency,0")
+fi
+if [ "$SET" = pacing ] || [ "$SET" = all ]; then
+    CASES+=("unpaced|" "--rate 20M|--rate 20M" "--adaptive|--adaptive" "--rate 20M --adaptive|--rate 20M --adaptive")
+fi
+SPARSE_CASES=()
+if [ "$SET" = sparse ] || [ "$SET" = all ]; then
+    SPARSE_CASES+=("--sparse|--sparse -d sparse.img" "-z --sparse|-z --sparse -d sparse.img.gz")
+fi
+if [ ${#CASES[@]} -eq 0 ] && [ ${#SPARSE_CASES[@]} -eq 0 ]; then
+    echo "Usage: $0 [profiles|pacing|sparse|all]" >&2
+    exit 1
+fi
+
+WORK=$(mktemp -d)
+mkdir "$WORK/server" "$WORK/client"
+head -c $((SIZE_MB << 20)) /dev/urandom > "$WORK/server/download.bin"
+cp "$WORK/server/download.bin" "$WORK/client/upload.bin"
+
+# Mostly zero image, a random 64 KiB block every 4 MiB, fully allocated on the server side.
+if [ ${#SPARSE_CASES[@]} -gt 0 ]; then
+    head -c $((SIZE_MB << 20)) /dev/zero > "$WORK/server/sparse.img"
+    for ((offset = 0; offset < SIZE_MB; offset += 4)); do
+        dd if=/dev/urandom of="$WORK/server/sparse.img" bs=64K count=1 seek=$((offset * 16)) conv=notrunc status=none
+    done
+    gzip -k "$WORK/server/sparse.img"
+fi
+
+python3 "$ROOT/bench/loopback_server.py" "$WORK/server" "$PORT" "$DELAY_US" &
+SERVER=$!
+trap 'kill $SERVER 2>/dev/null; rm -rf "$WORK"' EXIT
+sleep 0.5
+
+# Median of numbers on stdin, "-" if there are none.
+median()
+{
+    sort -n | awk '{ v[NR] = $1 } END { if (NR) print v[int((NR + 1) / 2)]; else print "-" }'
+}
+
+# Value of the first match of a sed pattern capturing one number.
+extract()
+{
+    sed -n "s/$1/\1/p" "$2" | head -n 1
+}
+
+echo "Loopback 127.0.0.1:$PORT, ${SIZE_MB} MiB file, -s $BLOCK, server reply delay $DELAY_US us, median of $RUNS runs."
+if [ ${#CASES[@]} -gt 0 ]; then
+    echo "Pacing accuracy: rate is the final pacing rate, delayed the sends held back by it, timer err their average wake up delay."
+    printf "%-24s %-9s %12s %12s %12s %8s %14s\n" "case" "direction" "goodput MB/s" "RTT us" "rate MB/s" "delayed" "timer err us"
+    for case in "${CASES[@]}"; do
+        label=${case%%|*}
+        options=${case#*|}
+        for direction in download upload; do
+            if [ $direction = download ]; then
+                request="-R -d download.bin"
+            else
+                request="-W -d upload.bin"
+            fi
+            : > "$WORK/results"
+            for ((run = 1; run <= RUNS; run++)); do
+                rm -f "$WORK/client/download.bin" "$WORK/server/upload.bin"
+                (cd "$WORK/client" && echo "$request -a 127.0.0.1,$PORT -s $BLOCK $options" | timeout 300 "$CLIENT") > "$WORK/log" 2>&1
+
+                #Transfers that did not complete intact are not counted.
+                if [ $direction = download ]; then
+                    cmp -s "$WORK/server/download.bin" "$WORK/client/download.bin" || { echo "$label $direction run $run failed" >&2; continue; }
+                else
+                    cmp -s "$WORK/client/upload.bin" "$WORK/server/upload.bin" || { echo "$label $direction run $run failed" >&2; continue; }
+                fi
+                goodput=$(extract '.*Transferred .* (\([0-9.]*\) MB\/s).*' "$WORK/log")
+                rtt=$(extract '.*average block round trip \([0-9.]*\) us.*' "$WORK/log")
+                rate=$(extract '.*Pacing rate \([0-9.]*\) MB\/s.*' "$WORK/log")
+                delayed=$(extract '.*, \([0-9]*\) sends delayed.*' "$WORK/log")
+                timer=$(extract '.*timer error average \([0-9.]*\) us.*' "$WORK/log")
+                echo "${goodput:--} ${rtt:--} ${rate:--} ${delayed:--} ${timer:--}" >> "$WORK/results"
+            done
+            printf "%-24s %-9s %12s %12s %12s %8s %14s\n" "$label" $direction \
+                "$(awk '$1 != "-" { print $1 }' "$WORK/results" | median)" "$(awk '$2 != "-" { print $2 }' "$WORK/results" | median)" \
+                "$(awk '$3 != "-" { print $3 }' "$WORK/results" | median)" "$(awk '$4 != "-" { print $4 }' "$WORK/results" | median)" \
+                "$(awk '$5 != "-" { print $5 }' "$WORK/results" | median)"
+        done
+    done
+fi
+
+# Sparse downloads: same bytes as the reference, fewer allocated bytes than the logical size.
+if [ ${#SPARSE_CASES[@]} -gt 0 ]; then
+    [ ${#CASES[@]} -gt 0 ] && echo
+    printf "%-24s %12s %12s %12s %8s\n" "case" "goodput MB/s" "logical B" "allocated B" "check"
+    for case in "${SPARSE_CASES[@]}"; do
+        label=${case%%|*}
+        options=${case#*|}
+        rm -f "$WORK/client/sparse.img"
+        (cd "$WORK/client" && echo "-R -a 127.0.0.1,$PORT -s $BLOCK $options" | timeout 300 "$CLIENT") > "$WORK/log" 2>&1
+
+        goodput=$(extract '.*Transferred .* (\([0-9.]*\) MB\/s).*' "$WORK/log")
+        logical=$(stat -c %s "$WORK/client/sparse.img" 2>/dev/null)
+        allocated=$(( $(stat -c %b "$WORK/client/sparse.img" 2>/dev/null || echo 0) * $(stat -c %B "$WORK/client/sparse.img" 2>/dev/null || echo 0) ))
+        check=ok
+        if ! cmp -s "$WORK/server/sparse.img" "$WORK/client/sparse.img"; then
+            check=differs
+        elif [ "$allocated" -ge "$logical" ]; then
+            check="not sparse"
+        fi
+        printf "%-24s %12s %12s %12s %8s\n" "$label" "${goodput:--}" "${logical:--}" "$allocated" "$check"
+    done
+fi
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+# Minimal TFTP server for the loopback benchmark (bench/loopback.sh), not for real use.
+# Serves RRQ/WRQ in octet mode with blksize, tsize and timeout options (RFC 2347-2349).
+# Usage: loopback_server.py <root directory> <port> [reply delay in us]
+# Reply delay emulates a slower server or path, each reply is delayed by 50-150 % of it (jitter).
+# Author: Tomáš Milostný (xmilos02)
+import os
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+OP_RRQ, OP_WRQ, OP_DATA, OP_ACK, OP_ERROR, OP_OACK = range(1, 7)
+RETRIES = 5
+reply_delay = 0.0
+
+
+def parse_request(packet):
+    fields = packet[2:].split(b'\0')
+    filename, options = fields[0].decode(), {}
+    for i in range(2, len(fields) - 1, 2):
+        options[fields[i].decode().lower()] = fields[i + 1].decode()
+    return filename, options
+
+
+def send_error(sock, address, message):
+    sock.sendto(struct.pack('!HH', OP_ERROR, 1) + message.encode() + b'\0', address)
+
+
+def exchange(sock, address, packet, accept):
+    """Sends packet until a reply satisfying accept arrives, returns the reply."""
+    for _ in range(RETRIES):
+        if reply_delay > 0:
+            time.sleep(reply_delay * random.uniform(0.5, 1.5))
+        sock.sendto(packet, address)
+        try:
+            while True:
+                reply, source = sock.recvfrom(65536)
+                if source == address and accept(reply):
+                    return reply
+        except socket.timeout:
+            continue
+    raise TimeoutError('client stopped answering')
+
+
+def is_ack(block):
+    return lambda reply: struct.unpack('!HH', reply[:4]) == (OP_ACK, block & 0xffff) if len(reply) >= 4 else False
+
+
+def is_data(block):
+    return lambda reply: len(reply) >= 4 and struct.unpack('!HH', reply[:4]) == (OP_DATA, block & 0xffff)
+
+
+def session(root, request, address):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(('127.0.0.1', 0))
+    opcode = struct.unpack('!H', request[:2])[0]
+    filename, options = parse_request(request)
+    path = os.path.join(root, os.path.basename(filename))
+    blksize = int(options.get('blksize', 512))
+    sock.settimeout(int(options.get('timeout', 1)))
+
+    accepted = {name: value for name, value in options.items() if name in ('blksize', 'timeout', 'tsize')}
+    try:
+        if opcode == OP_RRQ:
+            with open(path, 'rb') as file:
+                data = file.read()
+            if 'tsize' in accepted:
+                accepted['tsize'] = str(len(data))
+        else:
+            file = open(path, 'wb')
+    except OSError as error:
+        send_error(sock, address, error.strerror)
+        return
+
+    oack = struct.pack('!H', OP_OACK) + b''.join(k.encode() + b'\0' + v.encode() + b'\0' for k, v in accepted.items())
+    try:
+        if opcode == OP_RRQ:
+            block = 0
+            if accepted:
+                exchange(sock, address, oack, is_ack(0))
+            while True:
+                block += 1
+                chunk = data[(block - 1) * blksize:block * blksize]
+                exchange(sock, address, struct.pack('!HH', OP_DATA, block & 0xffff) + chunk, is_ack(block))
+                if len(chunk) < blksize:
+                    break
+        else:
+            block = 1
+            reply = exchange(sock, address, oack if accepted else struct.pack('!HH', OP_ACK, 0), is_data(block))
+            while True:
+                file.write(reply[4:])
+                if len(reply) - 4 < blksize:
+                    sock.sendto(struct.pack('!HH', OP_ACK, block & 0xffff), address)
+                    break
+                reply = exchange(sock, address, struct.pack('!HH', OP_ACK, block & 0xffff), is_data(block + 1))
+                block += 1
+            file.close()
+    except TimeoutError:
+        pass
+
+
+def main():
+    global reply_delay
+    root, port = sys.argv[1], int(sys.argv[2])
+    reply_delay = float(sys.argv[3]) / 1e6 if len(sys.argv) > 3 else 0.0
+    listener = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    listener.bind(('127.0.0.1', port))
+    while True:
+        request, address = listener.recvfrom(2048)
+        threading.Thread(target=session, args=(root, request, address), daemon=True).start()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,123 @@
+/**
+ * @brief Fuzz target of the TFTP packet parsers (make fuzz).
+ * @author Tomáš Milostný (xmilos02)
+ *
+ * Built as a libFuzzer target with clang++, or with FUZZ_STANDALONE as a self-contained
+ * random mutation driver (g++ has no libFuzzer), both under AddressSanitizer and UBSan.
+ */
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include "../TftpCodec.hpp"
+
+//Invariant violations abort, so the fuzzer reports them like a crash.
+#define FUZZ_CHECK(condition) \
+    do { if (!(condition)) { fprintf(stderr, "Check failed: %s (line %d)\n", #condition, __LINE__); abort(); } } while (0)
+
+static bool _Inside(std::string_view view, std::string_view packet)
+{
+    return view.data() >= packet.data() && view.data() + view.size() <= packet.data() + packet.size();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    //Exact sized copy, so reads past the packet are caught by AddressSanitizer.
+    std::vector<char> buffer(data, data + size);
+    std::string_view packet(buffer.data(), buffer.size());
+
+    auto opcode = TftpCodec::ParseOpcode(packet);
+    FUZZ_CHECK(size >= 2 || opcode == 0);
+
+    TftpOptions options;
+    if (TftpCodec::ParseOack(packet, options))
+    {
+        FUZZ_CHECK(opcode == OPCODE_OACK);
+        for (size_t i = 0; i < OPTION_COUNT; i++)
+        {
+            if (options.Has((TftpOption)i))
+                FUZZ_CHECK(options.Get((TftpOption)i) >= TftpOptionTable[i].Min && options.Get((TftpOption)i) <= TftpOptionTable[i].Max);
+        }
+    }
+
+    uint16_t errorCode;
+    std::string_view message;
+    if (TftpCodec::ParseError(packet, errorCode, message))
+    {
+        FUZZ_CHECK(opcode == OPCODE_ERROR && _Inside(message, packet));
+        FUZZ_CHECK(message.find('\0') == std::string_view::npos);
+
+        //Message survives a round trip through the encoder.
+        char encoded[TftpCodec::MaxErrorSize];
+        auto encodedSize = TftpCodec::EncodeError(encoded, sizeof(encoded), errorCode, message);
+        uint16_t decodedCode;
+        std::string_view decoded;
+        FUZZ_CHECK(TftpCodec::ParseError(std::string_view(encoded, encodedSize), decodedCode, decoded));
+        FUZZ_CHECK(decodedCode == errorCode && message.substr(0, decoded.size()) == decoded);
+    }
+
+    uint16_t blockN;
+    std::string_view blockData;
+    if (TftpCodec::ParseData(packet, blockN, blockData))
+        FUZZ_CHECK(opcode == OPCODE_DATA && _Inside(blockData, packet) && blockData.size() == size - TftpCodec::HeaderSize);
+
+    if (TftpCodec::ParseAck(packet, blockN))
+        FUZZ_CHECK(opcode == OPCODE_ACK && size >= TftpCodec::HeaderSize);
+
+    return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+//Seeds covering every packet type, mutated by random byte flips, truncation and extension.
+static std::vector<std::string> _Seeds()
+{
+    using namespace std::string_literals;
+    return {
+        "\0\6tsize\0" "5000\0blksize\0" "1428\0"s,
+        "\0\6BLKSIZE\0" "8\0timeout\0" "255\0unknown\0x\0"s,
+        "\0\5\0\1File not found\0"s,
+        "\0\5\0"s,
+        "\0\3\0\1data"s,
+        "\0\4\0\7"s,
+        "\0\4"s,
+    };
+}
+
+int main(int argc, char** argv)
+{
+    //Same run length option as libFuzzer: -max_total_time=<seconds>.
+    long seconds = 10;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "-max_total_time=", 16) == 0)
+            seconds = atol(argv[i] + 16);
+    }
+    auto seeds = _Seeds();
+    srand(1);
+    size_t runs = 0;
+    auto deadline = time(NULL) + seconds;
+    while (time(NULL) < deadline)
+    {
+        for (int batch = 0; batch < 10000; batch++, runs++)
+        {
+            auto input = seeds[rand() % seeds.size()];
+            for (int mutations = rand() % 8; mutations >= 0; mutations--)
+            {
+                switch (rand() % 4)
+                {
+                case 0: if (!input.empty()) input[rand() % input.size()] = rand(); break;
+                case 1: input.resize(rand() % (input.size() + 1));                 break;
+                case 2: input.push_back(rand() % 4 == 0 ? '\0' : rand());         break;
+                case 3: input.insert(rand() % (input.size() + 1), 1, '\0');        break;
+                }
+            }
+            LLVMFuzzerTestOneInput((const uint8_t*)input.data(), input.size());
+        }
+    }
+    printf("Done %zu runs in %ld s, no invariant violated.\n", runs, seconds);
+    return 0;
+}
+#endif
@@ -3,8 +3,11 @@
  * @author Tomáš Milostný (xmilos02)
  */
 #include <algorithm>
+#include <getopt.h>
 #include <iostream>
 #include "ArgumentParser.hpp"
+#include "BatchScheduler.hpp"
+#include "DirectoryMirror.hpp"
 #include "StampMessagePrinter.hpp"
 #include "Tftp.hpp"
 
@@ -33,13 +36,19 @@ ArgumentParser* ParsePromptArgs()
     return argParser;
 }
 
-void RunTftpClient(ArgumentParser* argParser)
+bool RunTftpClient(ArgumentParser* argParser)
 {
-    Tftp* tftp;
+    Tftp* tftp = NULL;
+    bool succeeded = false;
     try
     {
+        //Argument --mirror synchronizes a whole directory instead of one file.
+        if (!argParser->MirrorDirectory.empty())
+            return DirectoryMirror(argParser).Sync();
+
         tftp = new Tftp(argParser);
         tftp->Transfer();
+        succeeded = true;
     }
     catch (const std::runtime_error& exc) //Transfer error.
     {
@@ -48,10 +57,104 @@ void RunTftpClient(ArgumentParser* argParser)
     }
     //Free resources before next iteration and prompt.
     delete tftp;
+    return succeeded;
+}
+
+//Number of bytes with an optional binary K/M/G suffix, 0 if invalid.
+size_t ParseMemorySize(std::string value)
+{
+    try
+    {
+        size_t suffixPos;
+        size_t size = std::stoul(value, &suffixPos);
+        auto suffix = value.substr(suffixPos);
+
+        if (suffix == "K" || suffix == "k")
+            size <<= 10;
+        else if (suffix == "M")
+            size <<= 20;
+        else if (suffix == "G")
+            size <<= 30;
+        else if (!suffix.empty())
+            return 0;
+        return size;
+    }
+    catch (const std::exception&)
+    {
+        return 0;
+    }
 }
 
-int main()
+//Runs all commands from stdin concurrently (program argument -j), @returns Exit code.
+int RunBatch(size_t workers, size_t memoryBudget, size_t descriptorBudget)
 {
+    BatchScheduler scheduler(workers, memoryBudget, descriptorBudget);
+    std::string args;
+    size_t line = 0;
+
+    // Queue commands until end of file or "quit"/"exit", invalid ones are reported and skipped.
+    while (std::getline(std::cin, args))
+    {
+        line++;
+        if (args.empty() || std::all_of(args.begin(), args.end(), isspace))
+            continue;
+        try
+        {
+            auto argParser = new ArgumentParser(args);
+            if (argParser->ExitFlag)
+            {
+                delete argParser;
+                break;
+            }
+            if (argParser->HelpFlag)
+            {
+                delete argParser;
+                continue;
+            }
+            scheduler.Submit(argParser, line);
+        }
+        catch (const std::invalid_argument& exc)
+        {
+            std::cerr << "Line " << line << ": " << exc.what() << std::endl;
+        }
+    }
+    auto failed = scheduler.Run(RunTftpClient);
+    StampMessagePrinter::Print(scheduler.Describe());
+    return failed == 0 ? 0 : 1;
+}
+
+// Program options of the batch mode, commands themselves are read from stdin.
+const struct option programOptions[] =
+{
+    { "jobs",   required_argument, NULL, 'j' },
+    { "memory", required_argument, NULL, 'M' },
+    { "fds",    required_argument, NULL, 'F' },
+    { NULL, 0, NULL, 0 }
+};
+
+int main(int argc, char** argv)
+{
+    size_t workers = 0, memoryBudget = BatchScheduler::DefaultMemoryBudget(), descriptorBudget = BatchScheduler::DefaultDescriptorBudget();
+    int option;
+    bool validOptions = true;
+    while ((option = getopt_long(argc, argv, "j:", programOptions, NULL)) != -1)
+    {
+        switch (option)
+        {
+        case 'j':   workers = std::max(atoi(optarg), 0);            validOptions &= workers > 0;          break;
+        case 'M':   memoryBudget = ParseMemorySize(optarg);         validOptions &= memoryBudget > 0;     break;
+        case 'F':   descriptorBudget = std::max(atoi(optarg), 0);   validOptions &= descriptorBudget > 0; break;
+        default:    validOptions = false;                                                                 break;
+        }
+    }
+    if (!validOptions || optind < argc)
+    {
+        std::cerr << "Usage: " << argv[0] << " [-j <jobs> [--memory <bytes>[K|M|G]] [--fds <count>]] (batch mode reads commands from stdin)" << std::endl;
+        return 1;
+    }
+    if (workers > 0)
+        return RunBatch(workers, memoryBudget, descriptorBudget);
+
     // Load arguments until end of file (loading file redirected to stdin).
     while (!std::cin.eof())
     {